@@ -0,0 +1,425 @@
+/**
+ * Maximum sustainable frames per second of one connection sending camera images.
+ *
+ * The main thread plays the reactor. It hands frames to the strands of the camera topics through the work-stealing
+ * pool, with at most MAX_FRAME_NUM frames in flight as in the frame pool of a connection. Each strand copies the
+ * pixels into a recycled sensor_msgs::Image in the same way as decodeImage, identity or with a transform.
+ * Parsing BSON is not included: the pixels are read in place from the frame buffer.
+ *
+ * The pipeline cases compare the strands with the pipeline that they replaced, in which each of decode_worker_num
+ * lanes had a decoding thread and a publishing thread connected by an SPSC ring, and the frames of a topic always went
+ * to the same lane. Publishing to a subscriber in another process serializes the image, which is a copy of its pixels,
+ * so in these cases every image is also copied once more after it is decoded.
+ *
+ *   sigverse_ros_bridge-decode-bench [decode_worker_num] [seconds per case]
+ */
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/image_encodings.h>
+
+#include "image_conversion.hpp"
+#include "spsc_ring.hpp"
+#include "work_stealing_pool.hpp"
+
+#define MAX_FRAME_NUM     16
+#define LANE_MESSAGE_NUM  8 // Messages of a pipeline lane, more than its publish ring and its two threads hold
+#define PUBLISH_RING_SIZE 4
+
+class Connection;
+
+// One camera topic of the connection
+class BenchStrand : public WorkStealingTask
+{
+public:
+	Connection *connection;
+
+	std::vector<uint8_t> frameData; // The pixels of every frame of the topic
+	sensor_msgs::Image   receivedImage;
+	ImageTransform       imageTransform;
+
+	boost::mutex     mutex;
+	int              waitingFrameNum;
+	bool             isScheduled;
+
+	sensor_msgs::Image image; // Recycled like a message of the pool
+
+	bool                 isSerializing;
+	std::vector<uint8_t> serializedData;
+
+	BenchStrand() : connection(NULL), waitingFrameNum(0), isScheduled(false), isSerializing(false) {}
+
+	void run();
+};
+
+class Connection
+{
+public:
+	WorkStealingPool *decodePool;
+
+	boost::mutex              mutex;
+	boost::condition_variable frameReleased;
+	int                       inFlightFrameNum;
+
+	std::atomic<long> decodedFrameNum;
+
+	Connection(WorkStealingPool *decodePool) : decodePool(decodePool), inFlightFrameNum(0), decodedFrameNum(0) {}
+
+	void dispatch(BenchStrand &strand)
+	{
+		{
+			boost::mutex::scoped_lock lock(mutex);
+
+			while(inFlightFrameNum >= MAX_FRAME_NUM){ frameReleased.wait(lock); }
+
+			inFlightFrameNum++;
+		}
+
+		boost::mutex::scoped_lock lock(strand.mutex);
+
+		strand.waitingFrameNum++;
+
+		if(!strand.isScheduled)
+		{
+			strand.isScheduled = true;
+			decodePool->submit(&strand);
+		}
+	}
+
+	void release()
+	{
+		decodedFrameNum++;
+
+		boost::mutex::scoped_lock lock(mutex);
+
+		inFlightFrameNum--;
+		frameReleased.notify_one();
+	}
+
+	void waitForAll()
+	{
+		boost::mutex::scoped_lock lock(mutex);
+
+		while(inFlightFrameNum > 0){ frameReleased.wait(lock); }
+	}
+};
+
+void BenchStrand::run()
+{
+	int frameNum;
+
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		frameNum = waitingFrameNum;
+		waitingFrameNum = 0;
+	}
+
+	for(int i=0; i<frameNum; i++)
+	{
+		image.height       = receivedImage.height;
+		image.width        = receivedImage.width;
+		image.encoding     = receivedImage.encoding;
+		image.is_bigendian = receivedImage.is_bigendian;
+		image.step         = receivedImage.step;
+
+		if(imageTransform.isIdentity())
+		{
+			image.data.resize(frameData.size());
+			memcpy(&image.data[0], &frameData[0], frameData.size());
+		}
+		else
+		{
+			copyImageData(&frameData[0], frameData.size(), imageTransform, image);
+		}
+
+		if(isSerializing)
+		{
+			serializedData.resize(image.data.size());
+			memcpy(&serializedData[0], &image.data[0], image.data.size());
+		}
+
+		connection->release();
+	}
+
+	boost::mutex::scoped_lock lock(mutex);
+
+	if(waitingFrameNum > 0)
+	{
+		connection->decodePool->submit(this);
+		return;
+	}
+
+	isScheduled = false;
+}
+
+static void printResult(const std::string &name, int width, int height, int cameraNum, const std::string &encoding, const ImageTransform &imageTransform, double framesPerSec)
+{
+	const int pixelSize = 3; // bgr8
+
+	std::string transformName = imageTransform.isIdentity() ? "copy" : (imageTransform.flipVertical ? "flip " : "") + imageTransform.encoding;
+
+	std::cout << std::setw(4) << width << "x" << std::setw(4) << std::left << height << std::right
+	          << " " << std::setw(6) << encoding << " " << std::setw(11) << std::left << transformName << std::right
+	          << " " << std::setw(18) << std::left << name << std::right
+	          << " cameras:" << cameraNum
+	          << std::fixed << std::setprecision(1)
+	          << "  frames/s:" << std::setw(8) << framesPerSec
+	          << "  per camera:" << std::setw(8) << framesPerSec / cameraNum
+	          << "  MB/s:" << std::setw(8) << framesPerSec * width * height * pixelSize / 1.0e6 << std::endl;
+}
+
+static void runCase(WorkStealingPool &decodePool, int width, int height, int cameraNum, const std::string &encoding, const ImageTransform &imageTransform, double seconds, bool isSerializing = false)
+{
+	Connection connection(&decodePool);
+
+	std::vector<boost::shared_ptr<BenchStrand> > strands;
+
+	const int pixelSize = 3; // bgr8
+
+	for(int i=0; i<cameraNum; i++)
+	{
+		boost::shared_ptr<BenchStrand> strand(new BenchStrand());
+
+		strand->connection             = &connection;
+		strand->receivedImage.height   = height;
+		strand->receivedImage.width    = width;
+		strand->receivedImage.encoding = encoding;
+		strand->receivedImage.step     = width * pixelSize;
+		strand->imageTransform         = imageTransform;
+		strand->isSerializing          = isSerializing;
+
+		strand->frameData.resize((size_t)strand->receivedImage.step * height);
+
+		for(size_t j=0; j<strand->frameData.size(); j++){ strand->frameData[j] = (uint8_t)(j * 7); }
+
+		strands.push_back(strand);
+	}
+
+	// Warm up, so that the messages have their capacity
+	for(int i=0; i<cameraNum * 2; i++){ connection.dispatch(*strands[i % cameraNum]); }
+
+	connection.waitForAll();
+	connection.decodedFrameNum = 0;
+
+	boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+	boost::posix_time::ptime endTime   = startTime + boost::posix_time::microseconds((long)(seconds * 1.0e6));
+
+	for(long i=0; boost::posix_time::microsec_clock::universal_time() < endTime; i++)
+	{
+		connection.dispatch(*strands[i % cameraNum]);
+	}
+
+	connection.waitForAll();
+
+	double elapsed = (boost::posix_time::microsec_clock::universal_time() - startTime).total_microseconds() / 1.0e6;
+
+	printResult(isSerializing ? "strands+publish" : "strands", width, height, cameraNum, encoding, imageTransform, connection.decodedFrameNum / elapsed);
+
+	// The strands may still be in the pool after releasing their last frame
+	for(size_t i=0; i<strands.size(); i++)
+	{
+		while(true)
+		{
+			{
+				boost::mutex::scoped_lock lock(strands[i]->mutex);
+				if(!strands[i]->isScheduled){ break; }
+			}
+
+			boost::this_thread::yield();
+		}
+	}
+}
+
+// A lane of the replaced pipeline
+struct PipelineLane
+{
+	Connection *connection;
+
+	SpscRing<BenchStrand *> frameRing;   // A frame is represented by its topic, whose pixels it has
+	SpscRing<int>           publishRing; // Index of a decoded message
+
+	sensor_msgs::Image   messages[LANE_MESSAGE_NUM];
+	std::vector<uint8_t> serializedData;
+
+	PipelineLane(Connection *connection) : connection(connection), frameRing(MAX_FRAME_NUM), publishRing(PUBLISH_RING_SIZE) {}
+};
+
+// The decoding thread returns the frame buffer as soon as the message is built
+static void decodeLane(PipelineLane *lane)
+{
+	BenchStrand *strand;
+
+	for(int messageIndex = 0; lane->frameRing.pop(strand); messageIndex = (messageIndex + 1) % LANE_MESSAGE_NUM)
+	{
+		sensor_msgs::Image &image = lane->messages[messageIndex];
+
+		image.height       = strand->receivedImage.height;
+		image.width        = strand->receivedImage.width;
+		image.encoding     = strand->receivedImage.encoding;
+		image.is_bigendian = strand->receivedImage.is_bigendian;
+		image.step         = strand->receivedImage.step;
+
+		if(strand->imageTransform.isIdentity())
+		{
+			image.data.resize(strand->frameData.size());
+			memcpy(&image.data[0], &strand->frameData[0], strand->frameData.size());
+		}
+		else
+		{
+			copyImageData(&strand->frameData[0], strand->frameData.size(), strand->imageTransform, image);
+		}
+
+		{
+			boost::mutex::scoped_lock lock(lane->connection->mutex);
+
+			lane->connection->inFlightFrameNum--;
+			lane->connection->frameReleased.notify_one();
+		}
+
+		lane->publishRing.push(messageIndex);
+	}
+
+	lane->publishRing.close();
+}
+
+static void publishLane(PipelineLane *lane)
+{
+	int messageIndex;
+
+	while(lane->publishRing.pop(messageIndex))
+	{
+		const sensor_msgs::Image &image = lane->messages[messageIndex];
+
+		lane->serializedData.resize(image.data.size());
+		memcpy(&lane->serializedData[0], &image.data[0], image.data.size());
+
+		lane->connection->decodedFrameNum++;
+	}
+}
+
+static void runPipelineCase(int laneNum, int width, int height, int cameraNum, const std::string &encoding, const ImageTransform &imageTransform, double seconds)
+{
+	Connection connection(NULL);
+
+	std::vector<boost::shared_ptr<BenchStrand> > strands;
+
+	const int pixelSize = 3; // bgr8
+
+	for(int i=0; i<cameraNum; i++)
+	{
+		boost::shared_ptr<BenchStrand> strand(new BenchStrand());
+
+		strand->receivedImage.height   = height;
+		strand->receivedImage.width    = width;
+		strand->receivedImage.encoding = encoding;
+		strand->receivedImage.step     = width * pixelSize;
+		strand->imageTransform         = imageTransform;
+
+		strand->frameData.resize((size_t)strand->receivedImage.step * height);
+
+		for(size_t j=0; j<strand->frameData.size(); j++){ strand->frameData[j] = (uint8_t)(j * 7); }
+
+		strands.push_back(strand);
+	}
+
+	std::vector<boost::shared_ptr<PipelineLane> > lanes;
+	boost::thread_group                          laneThreads;
+
+	for(int i=0; i<laneNum; i++)
+	{
+		lanes.push_back(boost::shared_ptr<PipelineLane>(new PipelineLane(&connection)));
+
+		laneThreads.create_thread(boost::bind(&decodeLane,  lanes[i].get()));
+		laneThreads.create_thread(boost::bind(&publishLane, lanes[i].get()));
+	}
+
+	// Frames of a topic always go to the same lane to keep their order
+	auto dispatch = [&](long frameNo)
+	{
+		int cameraNo = (int)(frameNo % cameraNum);
+
+		{
+			boost::mutex::scoped_lock lock(connection.mutex);
+
+			while(connection.inFlightFrameNum >= MAX_FRAME_NUM){ connection.frameReleased.wait(lock); }
+
+			connection.inFlightFrameNum++;
+		}
+
+		BenchStrand *strand = strands[cameraNo].get();
+		lanes[cameraNo % laneNum]->frameRing.push(strand);
+	};
+
+	// Warm up, so that the messages have their capacity
+	for(int i=0; i<cameraNum * 2; i++){ dispatch(i); }
+
+	connection.waitForAll();
+
+	// The publishing threads may still count the warm-up frames
+	while(connection.decodedFrameNum < cameraNum * 2){ boost::this_thread::yield(); }
+
+	connection.decodedFrameNum = 0;
+
+	boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+	boost::posix_time::ptime endTime   = startTime + boost::posix_time::microseconds((long)(seconds * 1.0e6));
+
+	for(long i=0; boost::posix_time::microsec_clock::universal_time() < endTime; i++){ dispatch(i); }
+
+	for(int i=0; i<laneNum; i++){ lanes[i]->frameRing.close(); }
+
+	laneThreads.join_all();
+
+	double elapsed = (boost::posix_time::microsec_clock::universal_time() - startTime).total_microseconds() / 1.0e6;
+
+	printResult("pipeline+publish", width, height, cameraNum, encoding, imageTransform, connection.decodedFrameNum / elapsed);
+}
+
+int main(int argc, char **argv)
+{
+	int    workerNum = (argc > 1) ? atoi(argv[1]) : (int)boost::thread::hardware_concurrency();
+	double seconds   = (argc > 2) ? atof(argv[2]) : 3.0;
+
+	std::cout << "decode_worker_num:" << workerNum << "  " << seconds << " s per case" << std::endl;
+
+	WorkStealingPool decodePool(workerNum);
+
+	ImageTransform identity;
+
+	ImageTransform flipRgb;
+	flipRgb.flipVertical = true;
+	flipRgb.encoding     = sensor_msgs::image_encodings::RGB8;
+
+	const int resolutions[2][2] = { {1280, 720}, {1920, 1080} };
+
+	for(int i=0; i<2; i++)
+	{
+		int width  = resolutions[i][0];
+		int height = resolutions[i][1];
+
+		runCase(decodePool, width, height, 1, sensor_msgs::image_encodings::BGR8, identity, seconds);
+		runCase(decodePool, width, height, 1, sensor_msgs::image_encodings::BGR8, flipRgb,  seconds);
+		runCase(decodePool, width, height, 4, sensor_msgs::image_encodings::BGR8, identity, seconds);
+		runCase(decodePool, width, height, 4, sensor_msgs::image_encodings::BGR8, flipRgb,  seconds);
+	}
+
+	for(int i=0; i<2; i++)
+	{
+		int width  = resolutions[i][0];
+		int height = resolutions[i][1];
+
+		for(int cameraNum = 1; cameraNum <= 4; cameraNum *= 4)
+		{
+			runPipelineCase(workerNum, width, height, cameraNum, sensor_msgs::image_encodings::BGR8, flipRgb, seconds);
+			runCase(decodePool, width, height, cameraNum, sensor_msgs::image_encodings::BGR8, flipRgb, seconds, true);
+		}
+	}
+
+	return 0;
+}
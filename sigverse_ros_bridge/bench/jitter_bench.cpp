@@ -0,0 +1,131 @@
+/**
+ * Wake-up jitter of a periodic thread, like the control lane waiting for TF frames, under CPU and memory load.
+ *
+ * The thread wakes every millisecond at an absolute time and records how late it is, first with the OS scheduler and
+ * then with the CPUs and the SCHED_FIFO priority given, as ThreadTuning applies them to the bridge threads.
+ * The load threads copy large buffers without a pause, as Unity and the decode pool do.
+ *
+ *   sigverse_ros_bridge-jitter-bench [cpus] [fifo_priority] [seconds per run] [load_thread_num]
+ *
+ * e.g. sigverse_ros_bridge-jitter-bench "2" 50 10 4   (SCHED_FIFO needs CAP_SYS_NICE or a raised rtprio limit)
+ */
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "thread_tuning.hpp"
+
+#define PERIOD_NSEC  1000000L
+#define LOAD_SIZE    (32 * 1024 * 1024) // Larger than the caches
+
+static std::atomic<bool> isLoading(false);
+
+static void load()
+{
+	std::vector<uint8_t> src(LOAD_SIZE, 1);
+	std::vector<uint8_t> dst(LOAD_SIZE);
+
+	while(isLoading)
+	{
+		memcpy(&dst[0], &src[0], LOAD_SIZE);
+		src[0] = dst[LOAD_SIZE-1] + 1;
+	}
+}
+
+static void addNsec(struct timespec &time, long nsec)
+{
+	time.tv_nsec += nsec;
+
+	while(time.tv_nsec >= 1000000000L)
+	{
+		time.tv_nsec -= 1000000000L;
+		time.tv_sec++;
+	}
+}
+
+// Lateness of every wake-up in microseconds
+static void sample(const ThreadTuning &tuning, double seconds, std::vector<double> &latenesses)
+{
+	tuning.apply("jitter");
+
+	long wakeUpNum = (long)(seconds * 1.0e9 / PERIOD_NSEC);
+
+	latenesses.reserve(wakeUpNum);
+
+	struct timespec wakeUpTime;
+	clock_gettime(CLOCK_MONOTONIC, &wakeUpTime);
+
+	for(long i=0; i<wakeUpNum; i++)
+	{
+		addNsec(wakeUpTime, PERIOD_NSEC);
+
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeUpTime, NULL);
+
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		latenesses.push_back((double)(now.tv_sec - wakeUpTime.tv_sec) * 1.0e6 + (double)(now.tv_nsec - wakeUpTime.tv_nsec) / 1.0e3);
+	}
+}
+
+static void run(const std::string &name, const ThreadTuning &tuning, double seconds)
+{
+	std::vector<double> latenesses;
+
+	boost::thread samplingThread(boost::bind(&sample, boost::cref(tuning), seconds, boost::ref(latenesses)));
+	samplingThread.join();
+
+	std::sort(latenesses.begin(), latenesses.end());
+
+	size_t n = latenesses.size();
+
+	std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1)
+	          << "  wake-ups:" << n
+	          << "  p50:" << std::setw(8) << latenesses[n/2]          << " us"
+	          << "  p99:" << std::setw(8) << latenesses[n*99/100]     << " us"
+	          << "  p99.9:" << std::setw(8) << latenesses[n*999/1000] << " us"
+	          << "  max:" << std::setw(8) << latenesses[n-1]          << " us" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	ThreadTuning tuning;
+
+	if(argc > 1 && !ThreadTuning::parseCpuList(argv[1], tuning.cpus))
+	{
+		std::cout << "cpus is invalid. value=" << argv[1] << std::endl;
+		return 1;
+	}
+
+	tuning.fifoPriority = (argc > 2) ? atoi(argv[2]) : 0;
+
+	double seconds       = (argc > 3) ? atof(argv[3]) : 10.0;
+	int    loadThreadNum = (argc > 4) ? atoi(argv[4]) : (int)boost::thread::hardware_concurrency();
+
+	std::vector<boost::shared_ptr<boost::thread> > loadThreads;
+
+	isLoading = true;
+
+	for(int i=0; i<loadThreadNum; i++)
+	{
+		loadThreads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(&load)));
+	}
+
+	std::cout << "period: " << PERIOD_NSEC / 1000 << " us  load threads: " << loadThreadNum << std::endl;
+
+	run("OS scheduler", ThreadTuning(), seconds);
+	run("cpus:" + std::string(argc > 1 ? argv[1] : "") + " fifo:" + std::to_string(tuning.fifoPriority), tuning, seconds);
+
+	isLoading = false;
+
+	for(size_t i=0; i<loadThreads.size(); i++){ loadThreads[i]->join(); }
+
+	return 0;
+}
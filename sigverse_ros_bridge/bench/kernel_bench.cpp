@@ -0,0 +1,290 @@
+/**
+ * Time per frame of the vectorized conversion kernels and of the plain scalar versions in test/reference_kernels.hpp.
+ *
+ *   sigverse_ros_bridge-kernel-bench [seconds per kernel]
+ */
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "depth_conversion.hpp"
+#include "image_conversion.hpp"
+#include "image_pyramid.hpp"
+#include "scan_conversion.hpp"
+#include "reference_kernels.hpp"
+
+static double benchSeconds = 1.0;
+
+// Mean time of a call in microseconds
+template<typename Function>
+static double measureUsec(Function function)
+{
+	function(); // Warm up
+
+	boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+
+	long   callNum = 0;
+	double elapsed = 0.0;
+
+	while(elapsed < benchSeconds)
+	{
+		function();
+		callNum++;
+
+		elapsed = (boost::posix_time::microsec_clock::universal_time() - startTime).total_microseconds() / 1.0e6;
+	}
+
+	return elapsed * 1.0e6 / callNum;
+}
+
+// The time of a plain memcpy of the same frame is shown for the kernels fused into the copy
+static void report(const std::string &name, double kernelUsec, double referenceUsec, double copyUsec = -1.0)
+{
+	std::cout << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(1)
+	          << "  kernel:" << std::setw(8) << kernelUsec << " us"
+	          << "  scalar:" << std::setw(8) << referenceUsec << " us"
+	          << "  x" << referenceUsec / kernelUsec;
+
+	if(copyUsec >= 0.0){ std::cout << "  memcpy:" << std::setw(8) << copyUsec << " us"; }
+
+	std::cout << std::endl;
+}
+
+static CameraModel makeCameraModel(uint32_t width, uint32_t height)
+{
+	CameraModel cameraModel;
+
+	cameraModel.width  = width;
+	cameraModel.height = height;
+	cameraModel.fx     = 525.0;
+	cameraModel.fy     = 525.0;
+	cameraModel.cx     = width  * 0.5 - 0.5;
+	cameraModel.cy     = height * 0.5 - 0.5;
+
+	return cameraModel;
+}
+
+static sensor_msgs::Image makeDepthImage(const std::string &encoding, uint32_t width, uint32_t height)
+{
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> meters(0.3f, 8.0f);
+
+	bool isShort = (encoding == sensor_msgs::image_encodings::TYPE_16UC1);
+
+	sensor_msgs::Image depth;
+
+	depth.encoding     = encoding;
+	depth.width        = width;
+	depth.height       = height;
+	depth.is_bigendian = false;
+	depth.step         = width * (isShort ? sizeof(uint16_t) : sizeof(float));
+	depth.data.resize((size_t)depth.step * height);
+
+	for(size_t i=0; i<(size_t)width * height; i++)
+	{
+		float meter = (random() % 10 == 0) ? 0.0f : meters(random);
+
+		if(isShort)
+		{
+			uint16_t millimeters = (uint16_t)(meter * 1000.0f);
+			memcpy(&depth.data[i * sizeof(uint16_t)], &millimeters, sizeof(uint16_t));
+		}
+		else
+		{
+			memcpy(&depth.data[i * sizeof(float)], &meter, sizeof(float));
+		}
+	}
+
+	return depth;
+}
+
+static void benchDepthCloud(const std::string &encoding)
+{
+	CameraModel        cameraModel = makeCameraModel(640, 480);
+	sensor_msgs::Image depth       = makeDepthImage(encoding, 640, 480);
+
+	DepthCloudProjector projector;
+	projector.setCameraModel(cameraModel);
+
+	sensor_msgs::PointCloud2 cloud;
+	std::vector<float>       points;
+
+	double kernelUsec    = measureUsec([&]{ projector.project(depth, cloud); });
+	double referenceUsec = measureUsec([&]{ referenceDepthCloud(depth, cameraModel, points); });
+
+	report("depth cloud 640x480 " + encoding, kernelUsec, referenceUsec);
+}
+
+static void benchDepthScan(const std::string &encoding, int scanHeight)
+{
+	CameraModel        cameraModel = makeCameraModel(640, 480);
+	sensor_msgs::Image depth       = makeDepthImage(encoding, 640, 480);
+
+	DepthScanSettings settings;
+	settings.scanHeight = scanHeight;
+
+	DepthScanConverter converter;
+	converter.setCameraModel(cameraModel, settings);
+
+	sensor_msgs::LaserScan scan;
+	std::vector<float>     ranges;
+
+	double kernelUsec    = measureUsec([&]{ converter.convert(depth, scan); });
+	double referenceUsec = measureUsec([&]{ referenceDepthScan(depth, cameraModel, settings, ranges); });
+
+	report("depth scan 640x480 " + encoding + " rows:" + std::to_string(scanHeight), kernelUsec, referenceUsec);
+}
+
+static void benchScanCloud(int beamNum)
+{
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> meters(0.05f, 35.0f);
+
+	sensor_msgs::LaserScan scan;
+
+	scan.angle_min       = -2.35f;
+	scan.angle_increment = 4.7f / (beamNum-1);
+	scan.angle_max       = 2.35f;
+	scan.range_min       = 0.1f;
+	scan.range_max       = 30.0f;
+
+	for(int i=0; i<beamNum; i++)
+	{
+		scan.ranges     .push_back(meters(random));
+		scan.intensities.push_back((float)(random() % 1000));
+	}
+
+	ScanCloudProjector projector;
+
+	sensor_msgs::PointCloud2 cloud;
+	std::vector<float>       points;
+
+	double kernelUsec    = measureUsec([&]{ projector.project(scan, cloud); });
+	double referenceUsec = measureUsec([&]{ referenceScanCloud(scan, points); });
+
+	report("scan cloud " + std::to_string(beamNum) + " beams", kernelUsec, referenceUsec);
+}
+
+static void benchColorConversion(const std::string &srcEncoding, const std::string &dstEncoding, bool flipVertical)
+{
+	int channelNum = (int)referenceChannelNames(srcEncoding).size();
+
+	sensor_msgs::Image received;
+
+	received.encoding     = srcEncoding;
+	received.width        = 1280;
+	received.height       = 720;
+	received.is_bigendian = false;
+	received.step         = received.width * channelNum;
+	received.data.resize((size_t)received.step * received.height);
+
+	for(size_t i=0; i<received.data.size(); i++){ received.data[i] = (uint8_t)(i * 7); }
+
+	ImageTransform transform;
+	transform.flipVertical = flipVertical;
+	transform.encoding     = dstEncoding;
+
+	sensor_msgs::Image   image;
+	std::vector<uint8_t> data;
+	std::vector<uint8_t> copiedData(received.data.size());
+
+	double kernelUsec = measureUsec([&]
+	{
+		image.encoding = received.encoding;
+		image.width    = received.width;
+		image.height   = received.height;
+		image.step     = received.step;
+
+		copyImageData(&received.data[0], received.data.size(), transform, image);
+	});
+
+	double referenceUsec = measureUsec([&]{ referenceConvertColor(received, dstEncoding, flipVertical, data); });
+	double copyUsec      = measureUsec([&]{ memcpy(&copiedData[0], &received.data[0], received.data.size()); });
+
+	report("image 1280x720 " + srcEncoding + " -> " + dstEncoding + (flipVertical ? " flip" : ""), kernelUsec, referenceUsec, copyUsec);
+}
+
+static void benchDepthConversion(const std::string &srcEncoding, bool isBigEndian, const std::string &dstEncoding)
+{
+	sensor_msgs::Image received = makeDepthImage(srcEncoding, 640, 480);
+
+	// The values do not matter for the time
+	received.is_bigendian = isBigEndian;
+
+	ImageTransform transform;
+	transform.encoding = dstEncoding;
+
+	sensor_msgs::Image   image;
+	std::vector<uint8_t> data;
+	std::vector<uint8_t> copiedData(received.data.size());
+
+	double kernelUsec = measureUsec([&]
+	{
+		image.encoding     = received.encoding;
+		image.width        = received.width;
+		image.height       = received.height;
+		image.is_bigendian = received.is_bigendian;
+		image.step         = received.step;
+
+		copyImageData(&received.data[0], received.data.size(), transform, image);
+	});
+
+	double referenceUsec = measureUsec([&]{ referenceConvertDepth(received, dstEncoding, false, data); });
+	double copyUsec      = measureUsec([&]{ memcpy(&copiedData[0], &received.data[0], received.data.size()); });
+
+	report("depth 640x480 " + srcEncoding + (isBigEndian ? " BE" : "") + " -> " + dstEncoding, kernelUsec, referenceUsec, copyUsec);
+}
+
+static void benchDownscale(const std::string &encoding, int channelNum, uint32_t width, uint32_t height)
+{
+	sensor_msgs::Image src;
+
+	src.encoding     = encoding;
+	src.width        = width;
+	src.height       = height;
+	src.is_bigendian = false;
+	src.step         = width * channelNum;
+	src.data.resize((size_t)src.step * height);
+
+	for(size_t i=0; i<src.data.size(); i++){ src.data[i] = (uint8_t)(i * 7); }
+
+	sensor_msgs::Image   dst;
+	std::vector<uint8_t> data;
+
+	double kernelUsec    = measureUsec([&]{ downscaleImage(src, dst); });
+	double referenceUsec = measureUsec([&]{ referenceDownscale(src, channelNum, data); });
+
+	report("half " + std::to_string(width) + "x" + std::to_string(height) + " " + encoding, kernelUsec, referenceUsec);
+}
+
+int main(int argc, char **argv)
+{
+	if(argc > 1){ benchSeconds = atof(argv[1]); }
+
+	benchDepthCloud(sensor_msgs::image_encodings::TYPE_32FC1);
+	benchDepthCloud(sensor_msgs::image_encodings::TYPE_16UC1);
+	benchDepthScan (sensor_msgs::image_encodings::TYPE_32FC1, 1);
+	benchDepthScan (sensor_msgs::image_encodings::TYPE_32FC1, 10);
+	benchDepthScan (sensor_msgs::image_encodings::TYPE_16UC1, 10);
+	benchScanCloud (360);
+	benchScanCloud (1081);
+
+	benchColorConversion(sensor_msgs::image_encodings::BGR8,  sensor_msgs::image_encodings::RGB8, true);
+	benchColorConversion(sensor_msgs::image_encodings::BGRA8, sensor_msgs::image_encodings::RGB8, true);
+	benchColorConversion(sensor_msgs::image_encodings::RGBA8, sensor_msgs::image_encodings::RGB8, false);
+
+	benchDepthConversion(sensor_msgs::image_encodings::TYPE_32FC1, false, sensor_msgs::image_encodings::TYPE_16UC1);
+	benchDepthConversion(sensor_msgs::image_encodings::TYPE_16UC1, false, sensor_msgs::image_encodings::TYPE_32FC1);
+	benchDepthConversion(sensor_msgs::image_encodings::TYPE_32FC1, true,  sensor_msgs::image_encodings::TYPE_32FC1);
+
+	benchDownscale(sensor_msgs::image_encodings::MONO8, 1, 1280, 720);
+	benchDownscale(sensor_msgs::image_encodings::RGB8,  3, 1280, 720);
+	benchDownscale(sensor_msgs::image_encodings::RGB8,  3, 1920, 1080);
+	benchDownscale(sensor_msgs::image_encodings::BGRA8, 4, 1920, 1080);
+
+	return 0;
+}
@@ -0,0 +1,355 @@
+/**
+ * Time that TF frames wait behind the camera frames of the same connection, in the three ways the bridge has processed them.
+ *
+ *   inline    The receiving thread decodes every frame itself, as before the priority lanes.
+ *   one lane  The reactor hands every frame to one thread in arrival order (~priority_lanes:=false).
+ *   lanes     TF frames go to the control lane and camera frames to the strands of the decode pool (~priority_lanes:=true).
+ *
+ * The main thread plays the reactor. It receives TF lists at 100 Hz and 1080p bgr8 images from camera_num cameras at 30 Hz,
+ * copies every image once as if it were read from the socket, and hands the frames over, with at most MAX_FRAME_NUM
+ * frames in flight as in the frame pool of a connection. An image is flipped and converted to rgb8 as decodeImage does
+ * with a transform. The wait of a TF frame is the time from when it was due until it was decoded.
+ * Publishing is not included. The lane thread runs with the SCHED_FIFO priority given, as ~control_fifo_priority does.
+ *
+ *   sigverse_ros_bridge-lane-bench [camera_num] [seconds per mode] [decode_worker_num] [control_fifo_priority]
+ */
+#include <algorithm>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/image_encodings.h>
+
+#include "image_conversion.hpp"
+#include "spsc_ring.hpp"
+#include "thread_tuning.hpp"
+#include "work_stealing_pool.hpp"
+
+#define MAX_FRAME_NUM  16
+#define TF_RATE        100.0 // [Hz]
+#define TF_LINK_NUM    30
+#define CAMERA_RATE    30.0  // [Hz]
+#define CAMERA_WIDTH   1920
+#define CAMERA_HEIGHT  1080
+
+enum LaneMode
+{
+	MODE_INLINE,
+	MODE_ONE_LANE,
+	MODE_LANES,
+};
+
+static double nowUsec()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double)now.tv_sec * 1.0e6 + (double)now.tv_nsec / 1.0e3;
+}
+
+struct BenchFrame
+{
+	bool   isTfList;
+	int    cameraNo;
+	double dueUsec; // When the frame was due from the simulator
+
+	std::vector<uint8_t> data; // Keeps its capacity, like a frame buffer
+};
+
+// The frames of a connection
+class FramePool
+{
+private:
+	std::vector<BenchFrame>   frames;
+	std::vector<BenchFrame *> freeFrames;
+
+	boost::mutex              mutex;
+	boost::condition_variable frameReleased;
+
+public:
+	FramePool() : frames(MAX_FRAME_NUM)
+	{
+		for(size_t i=0; i<frames.size(); i++){ freeFrames.push_back(&frames[i]); }
+	}
+
+	BenchFrame *take()
+	{
+		boost::mutex::scoped_lock lock(mutex);
+
+		while(freeFrames.empty()){ frameReleased.wait(lock); }
+
+		BenchFrame *frame = freeFrames.back();
+		freeFrames.pop_back();
+
+		return frame;
+	}
+
+	void release(BenchFrame *frame)
+	{
+		boost::mutex::scoped_lock lock(mutex);
+
+		freeFrames.push_back(frame);
+		frameReleased.notify_one();
+	}
+
+	void waitForAll()
+	{
+		boost::mutex::scoped_lock lock(mutex);
+
+		while(freeFrames.size() < frames.size()){ frameReleased.wait(lock); }
+	}
+};
+
+// Decodes the frames of one mode and keeps the results
+class Decoder
+{
+public:
+	FramePool &framePool;
+
+	ImageTransform                  imageTransform;
+	std::vector<sensor_msgs::Image> images; // Recycled per camera like the messages of the pools
+	std::vector<double>             transforms;
+
+	std::vector<double> tfWaits; // [us] Written by one thread at a time in every mode
+	std::atomic<long>   decodedImageNum;
+
+	Decoder(FramePool &framePool, int cameraNum) : framePool(framePool), images(cameraNum), transforms(TF_LINK_NUM * 7), decodedImageNum(0)
+	{
+		imageTransform.flipVertical = true;
+		imageTransform.encoding     = sensor_msgs::image_encodings::RGB8;
+	}
+
+	void decode(BenchFrame *frame)
+	{
+		if(frame->isTfList)
+		{
+			// Translation and rotation of every link
+			for(size_t i=0; i<transforms.size(); i++){ transforms[i] = (double)frame->data[i % frame->data.size()] * 0.001; }
+
+			tfWaits.push_back(nowUsec() - frame->dueUsec);
+		}
+		else
+		{
+			sensor_msgs::Image &image = images[frame->cameraNo];
+
+			image.height       = CAMERA_HEIGHT;
+			image.width        = CAMERA_WIDTH;
+			image.encoding     = sensor_msgs::image_encodings::BGR8;
+			image.is_bigendian = false;
+			image.step         = CAMERA_WIDTH * 3;
+
+			copyImageData(&frame->data[0], frame->data.size(), imageTransform, image);
+
+			decodedImageNum++;
+		}
+
+		framePool.release(frame);
+	}
+};
+
+// The camera topic of a connection in the decode pool
+class BenchStrand : public WorkStealingTask
+{
+public:
+	Decoder          *decoder;
+	WorkStealingPool *decodePool;
+
+	boost::mutex             mutex;
+	std::deque<BenchFrame *> frames;
+	bool                     isScheduled;
+
+	BenchStrand() : decoder(NULL), decodePool(NULL), isScheduled(false) {}
+
+	void schedule(BenchFrame *frame)
+	{
+		boost::mutex::scoped_lock lock(mutex);
+
+		frames.push_back(frame);
+
+		if(!isScheduled)
+		{
+			isScheduled = true;
+			decodePool->submit(this);
+		}
+	}
+
+	void run()
+	{
+		std::deque<BenchFrame *> waitingFrames;
+
+		{
+			boost::mutex::scoped_lock lock(mutex);
+			waitingFrames.swap(frames);
+		}
+
+		for(size_t i=0; i<waitingFrames.size(); i++){ decoder->decode(waitingFrames[i]); }
+
+		boost::mutex::scoped_lock lock(mutex);
+
+		if(!frames.empty())
+		{
+			decodePool->submit(this);
+			return;
+		}
+
+		isScheduled = false;
+	}
+
+	bool isIdle()
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		return !isScheduled;
+	}
+};
+
+static ThreadTuning controlTuning;
+
+static void processLane(SpscRing<BenchFrame *> *frameRing, Decoder *decoder)
+{
+	controlTuning.apply("lane");
+
+	BenchFrame *frame;
+
+	while(frameRing->pop(frame)){ decoder->decode(frame); }
+}
+
+static void runMode(LaneMode mode, WorkStealingPool &decodePool, int cameraNum, double seconds)
+{
+	FramePool framePool;
+	Decoder   decoder(framePool, cameraNum);
+
+	std::vector<uint8_t> pixels((size_t)CAMERA_WIDTH * CAMERA_HEIGHT * 3); // The bytes in the socket
+
+	for(size_t i=0; i<pixels.size(); i++){ pixels[i] = (uint8_t)(i * 7); }
+
+	SpscRing<BenchFrame *> frameRing(MAX_FRAME_NUM);
+
+	boost::shared_ptr<boost::thread> laneThread;
+
+	if(mode != MODE_INLINE){ laneThread.reset(new boost::thread(&processLane, &frameRing, &decoder)); }
+
+	std::vector<boost::shared_ptr<BenchStrand> > strands;
+
+	for(int i=0; i<cameraNum; i++)
+	{
+		strands.push_back(boost::shared_ptr<BenchStrand>(new BenchStrand()));
+
+		strands[i]->decoder    = &decoder;
+		strands[i]->decodePool = &decodePool;
+	}
+
+	double tfPeriod     = 1.0e6 / TF_RATE;
+	double cameraPeriod = 1.0e6 / (CAMERA_RATE * cameraNum);
+
+	double startUsec      = nowUsec();
+	double endUsec        = startUsec + seconds * 1.0e6;
+	double nextTfUsec     = startUsec;
+	double nextCameraUsec = startUsec;
+
+	long cameraSeq = 0;
+
+	for(double now = startUsec; now < endUsec; now = nowUsec())
+	{
+		bool isTfDue     = (now >= nextTfUsec);
+		bool isCameraDue = (cameraNum > 0 && now >= nextCameraUsec);
+
+		if(!isTfDue && !isCameraDue)
+		{
+			double nextUsec = (cameraNum > 0) ? std::min(nextTfUsec, nextCameraUsec) : nextTfUsec;
+
+			usleep((useconds_t)(nextUsec - now));
+			continue;
+		}
+
+		BenchFrame *frame = framePool.take();
+
+		frame->isTfList = isTfDue;
+
+		if(isTfDue)
+		{
+			frame->dueUsec = nextTfUsec;
+			frame->data.resize(TF_LINK_NUM * 200); // About the BSON size of a TF list
+			nextTfUsec += tfPeriod;
+		}
+		else
+		{
+			frame->dueUsec  = nextCameraUsec;
+			frame->cameraNo = (int)(cameraSeq++ % cameraNum);
+			frame->data.resize(pixels.size());
+			memcpy(&frame->data[0], &pixels[0], pixels.size()); // Receiving
+			nextCameraUsec += cameraPeriod;
+		}
+
+		if(mode == MODE_INLINE)
+		{
+			decoder.decode(frame);
+		}
+		else if(mode == MODE_ONE_LANE || frame->isTfList)
+		{
+			frameRing.push(frame);
+		}
+		else
+		{
+			strands[frame->cameraNo]->schedule(frame);
+		}
+	}
+
+	framePool.waitForAll();
+
+	double elapsed = (nowUsec() - startUsec) / 1.0e6;
+
+	frameRing.close();
+
+	if(laneThread){ laneThread->join(); }
+
+	for(size_t i=0; i<strands.size(); i++)
+	{
+		while(!strands[i]->isIdle()){ boost::this_thread::yield(); }
+	}
+
+	std::vector<double> &waits = decoder.tfWaits;
+
+	std::sort(waits.begin(), waits.end());
+
+	size_t n = waits.size();
+
+	const char *modeNames[] = { "inline", "one lane", "lanes" };
+
+	std::cout << std::left << std::setw(9) << modeNames[mode] << std::right << std::fixed << std::setprecision(0)
+	          << " cameras:" << cameraNum
+	          << "  tf lists:" << n
+	          << "  wait p50:" << std::setw(6) << waits[n/2]          << " us"
+	          << "  p90:"      << std::setw(6) << waits[n*9/10]       << " us"
+	          << "  p99:"      << std::setw(6) << waits[n*99/100]     << " us"
+	          << "  max:"      << std::setw(6) << waits[n-1]          << " us"
+	          << std::setprecision(1)
+	          << "  images/s:" << std::setw(6) << decoder.decodedImageNum / elapsed << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	int    cameraNum = (argc > 1) ? atoi(argv[1]) : 2;
+	double seconds   = (argc > 2) ? atof(argv[2]) : 10.0;
+	int    workerNum = (argc > 3) ? atoi(argv[3]) : (int)boost::thread::hardware_concurrency();
+
+	controlTuning.fifoPriority = (argc > 4) ? atoi(argv[4]) : 0;
+
+	std::cout << "1080p bgr8 -> flip rgb8 at " << CAMERA_RATE << " Hz, " << TF_LINK_NUM << "-link TF lists at " << TF_RATE << " Hz"
+	          << "  decode_worker_num:" << workerNum << "  control_fifo_priority:" << controlTuning.fifoPriority
+	          << "  " << seconds << " s per mode" << std::endl;
+
+	WorkStealingPool decodePool(workerNum);
+
+	runMode(MODE_INLINE,   decodePool, cameraNum, seconds);
+	runMode(MODE_ONE_LANE, decodePool, cameraNum, seconds);
+	runMode(MODE_LANES,    decodePool, cameraNum, seconds);
+
+	return 0;
+}
@@ -0,0 +1,359 @@
+/**
+ * Load client that plays the simulator, to measure the latency of TF lists behind camera frames end to end.
+ *
+ * Each robot has its own connection to a running bridge and sends rgb8 camera images and TF lists over it, as Unity does.
+ * The TF chain load_robot<r>/base -> load_robot<r>/link_<k> moves on every list, so that neither the deadband nor
+ * the static promotion drops it, and is stamped with ROS time when it is sent. The client subscribes to /tf and takes
+ * the latency of a list as the time from its stamp until it is received. The percentiles and the transforms per second
+ * sent and received are printed at the end.
+ *
+ *   rosrun sigverse_ros_bridge sigverse_ros_bridge-load-client _camera_num:=2 _camera_width:=1920 _camera_height:=1080
+ *   rosrun sigverse_ros_bridge sigverse_ros_bridge-load-client _robot_num:=4 _camera_num:=0 _tf_link_num:=200 _tf_rate:=100
+ *
+ * Run it once against a bridge with ~priority_lanes:=false and once with true.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <boost/thread.hpp>
+
+#include <ros/ros.h>
+#include <tf2_msgs/TFMessage.h>
+
+#include <bsoncxx/builder/basic/array.hpp>
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/builder/basic/kvp.hpp>
+#include <bsoncxx/types.hpp>
+
+using bsoncxx::builder::basic::kvp;
+using bsoncxx::builder::basic::sub_array;
+using bsoncxx::builder::basic::sub_document;
+
+#define DEFAULT_HOST  "127.0.0.1"
+#define DEFAULT_PORT  50001
+
+#define ROBOT_PREFIX  "load_robot"
+
+struct LoadSettings
+{
+	std::string host;
+	int         port;
+	int         cameraNum;
+	int         cameraWidth;
+	int         cameraHeight;
+	double      cameraRate; // [Hz]
+	int         tfLinkNum;
+	double      tfRate;     // [Hz]
+	double      duration;   // [sec]
+	int         robotNum;
+};
+
+static std::atomic<bool> isSending(false);
+
+static std::atomic<long> sentCameraFrameNum(0);
+static std::atomic<long> sentTfListNum(0);
+static std::atomic<long> sentTransformNum(0);
+static std::atomic<long> receivedTransformNum(0);
+
+static boost::mutex        latencyMutex;
+static std::vector<double> tfLatencies; // [ms]
+
+static void appendHeader(sub_document header, const std::string &frameId, const ros::Time &stamp, uint32_t seq)
+{
+	header.append(kvp("seq", (int32_t)seq));
+	header.append(kvp("stamp", [&](sub_document stampDocument)
+	{
+		stampDocument.append(kvp("secs",  (int32_t)stamp.sec));
+		stampDocument.append(kvp("nsecs", (int32_t)stamp.nsec));
+	}));
+	header.append(kvp("frame_id", frameId));
+}
+
+static bsoncxx::document::value makeImageFrame(int robotNo, int cameraNo, const LoadSettings &settings, const std::vector<uint8_t> &pixels, uint32_t seq)
+{
+	std::string robotName  = ROBOT_PREFIX + std::to_string(robotNo);
+	std::string cameraName = "camera" + std::to_string(cameraNo);
+
+	bsoncxx::builder::basic::document document;
+
+	document.append(kvp("topic", "/load_client/" + robotName + "/" + cameraName + "/image_raw"));
+	document.append(kvp("type",  "sensor_msgs/Image"));
+	document.append(kvp("msg", [&](sub_document msg)
+	{
+		msg.append(kvp("header", [&](sub_document header){ appendHeader(header, robotName + "/" + cameraName, ros::Time::now(), seq); }));
+		msg.append(kvp("height",       (int32_t)settings.cameraHeight));
+		msg.append(kvp("width",        (int32_t)settings.cameraWidth));
+		msg.append(kvp("encoding",     "rgb8"));
+		msg.append(kvp("is_bigendian", (int32_t)0));
+		msg.append(kvp("step",         (int32_t)(settings.cameraWidth * 3)));
+		msg.append(kvp("data", bsoncxx::types::b_binary{bsoncxx::binary_sub_type::k_binary, (uint32_t)pixels.size(), &pixels[0]}));
+	}));
+
+	return document.extract();
+}
+
+static bsoncxx::document::value makeTfListFrame(int robotNo, const LoadSettings &settings, uint32_t seq)
+{
+	std::string robotName = ROBOT_PREFIX + std::to_string(robotNo);
+
+	ros::Time stamp = ros::Time::now();
+
+	double phase = stamp.toSec();
+
+	bsoncxx::builder::basic::document document;
+
+	document.append(kvp("topic", "/tf"));
+	document.append(kvp("type",  "sigverse/TfList"));
+	document.append(kvp("msg", [&](sub_array links)
+	{
+		for(int i=0; i<settings.tfLinkNum; i++)
+		{
+			std::string parentFrameId = robotName + ((i==0) ? "/base" : "/link_" + std::to_string(i-1));
+
+			links.append([&](sub_document link)
+			{
+				link.append(kvp("header", [&](sub_document header){ appendHeader(header, parentFrameId, stamp, seq); }));
+				link.append(kvp("child_frame_id", robotName + "/link_" + std::to_string(i)));
+				link.append(kvp("transform", [&](sub_document transform)
+				{
+					transform.append(kvp("translation", [&](sub_document translation)
+					{
+						translation.append(kvp("x", 0.1 + 0.01 * std::sin(phase + i)));
+						translation.append(kvp("y", 0.0));
+						translation.append(kvp("z", 0.05));
+					}));
+					transform.append(kvp("rotation", [&](sub_document rotation)
+					{
+						rotation.append(kvp("x", 0.0));
+						rotation.append(kvp("y", 0.0));
+						rotation.append(kvp("z", 0.0));
+						rotation.append(kvp("w", 1.0));
+					}));
+				}));
+			});
+		}
+	}));
+
+	return document.extract();
+}
+
+static bool sendFrame(int socketFd, const bsoncxx::document::value &frame)
+{
+	// The length prefix of a BSON document is the frame length the bridge reads
+	const uint8_t *data = frame.view().data();
+	size_t         size = frame.view().length();
+
+	while(size > 0)
+	{
+		ssize_t sentSize = send(socketFd, data, size, MSG_NOSIGNAL);
+
+		if(sentSize <= 0){ return false; }
+
+		data += sentSize;
+		size -= sentSize;
+	}
+
+	return true;
+}
+
+static int connectToBridge(const LoadSettings &settings)
+{
+	int socketFd = socket(AF_INET, SOCK_STREAM, 0);
+
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+
+	address.sin_family = AF_INET;
+	address.sin_port   = htons(settings.port);
+
+	if(socketFd < 0 || inet_pton(AF_INET, settings.host.c_str(), &address.sin_addr) != 1 ||
+	   connect(socketFd, (struct sockaddr *)&address, sizeof(address)) != 0)
+	{
+		std::cout << "Could not connect to " << settings.host << ":" << settings.port << std::endl;
+		if(socketFd >= 0){ close(socketFd); }
+		return -1;
+	}
+
+	int noDelay = 1;
+	setsockopt(socketFd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+	return socketFd;
+}
+
+// Sends every frame when it is due, the cameras in turn. A TF list that falls due during a camera frame waits for it,
+// as it does in the simulator.
+static void sendFrames(int robotNo, int socketFd, const LoadSettings &settings)
+{
+	std::vector<uint8_t> pixels((size_t)settings.cameraWidth * settings.cameraHeight * 3);
+
+	for(size_t i=0; i<pixels.size(); i++){ pixels[i] = (uint8_t)(i * 7); }
+
+	ros::WallDuration cameraPeriod(1.0 / (settings.cameraRate * std::max(settings.cameraNum, 1)));
+	ros::WallDuration tfPeriod    (1.0 / settings.tfRate);
+
+	ros::WallTime nextCameraTime = ros::WallTime::now();
+	ros::WallTime nextTfTime     = ros::WallTime::now();
+
+	uint32_t cameraSeq = 0;
+	uint32_t tfSeq     = 0;
+
+	while(isSending)
+	{
+		ros::WallTime now = ros::WallTime::now();
+
+		if(now >= nextTfTime)
+		{
+			if(!sendFrame(socketFd, makeTfListFrame(robotNo, settings, tfSeq++))){ break; }
+
+			sentTfListNum++;
+			sentTransformNum += settings.tfLinkNum;
+			nextTfTime += tfPeriod;
+		}
+		else if(settings.cameraNum > 0 && now >= nextCameraTime)
+		{
+			if(!sendFrame(socketFd, makeImageFrame(robotNo, cameraSeq % settings.cameraNum, settings, pixels, cameraSeq / settings.cameraNum))){ break; }
+
+			cameraSeq++;
+			sentCameraFrameNum++;
+			nextCameraTime += cameraPeriod;
+		}
+		else
+		{
+			ros::WallTime wakeUpTime = (settings.cameraNum > 0) ? std::min(nextTfTime, nextCameraTime) : nextTfTime;
+
+			(wakeUpTime - now).sleep();
+		}
+	}
+
+	if(isSending){ std::cout << "The bridge closed the connection of robot " << robotNo << std::endl; }
+}
+
+static void tfCallback(const tf2_msgs::TFMessage::ConstPtr &tfMessage)
+{
+	ros::Time now = ros::Time::now();
+
+	const geometry_msgs::TransformStamped *firstTransform = NULL;
+	int                                    transformNum   = 0;
+
+	// A message is the list of one robot, and all its transforms have the same stamp.
+	// The bridge prepends ~tf_prefix to the frame ids.
+	for(size_t i=0; i<tfMessage->transforms.size(); i++)
+	{
+		if(tfMessage->transforms[i].child_frame_id.find(ROBOT_PREFIX) == std::string::npos){ continue; }
+
+		if(firstTransform == NULL){ firstTransform = &tfMessage->transforms[i]; }
+
+		transformNum++;
+	}
+
+	if(firstTransform == NULL){ return; }
+
+	receivedTransformNum += transformNum;
+
+	boost::mutex::scoped_lock lock(latencyMutex);
+
+	tfLatencies.push_back((now - firstTransform->header.stamp).toSec() * 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+	ros::init(argc, argv, "sigverse_ros_bridge_load_client");
+
+	ros::NodeHandle nodeHandle;
+	ros::NodeHandle privateNodeHandle("~");
+
+	LoadSettings settings;
+
+	privateNodeHandle.param<std::string>("host", settings.host, DEFAULT_HOST);
+	privateNodeHandle.param("port",          settings.port,         DEFAULT_PORT);
+	privateNodeHandle.param("camera_num",    settings.cameraNum,    1);
+	privateNodeHandle.param("camera_width",  settings.cameraWidth,  1280);
+	privateNodeHandle.param("camera_height", settings.cameraHeight, 720);
+	privateNodeHandle.param("camera_rate",   settings.cameraRate,   30.0);
+	privateNodeHandle.param("tf_link_num",   settings.tfLinkNum,    30);
+	privateNodeHandle.param("tf_rate",       settings.tfRate,       100.0);
+	privateNodeHandle.param("duration",      settings.duration,     30.0);
+	privateNodeHandle.param("robot_num",     settings.robotNum,     1);
+
+	ros::Subscriber tfSubscriber = nodeHandle.subscribe("/tf", 1000, &tfCallback, ros::TransportHints().tcpNoDelay());
+
+	ros::AsyncSpinner spinner(1);
+	spinner.start();
+
+	std::vector<int> socketFds;
+
+	for(int i=0; i<settings.robotNum; i++)
+	{
+		int socketFd = connectToBridge(settings);
+
+		if(socketFd < 0){ return 1; }
+
+		socketFds.push_back(socketFd);
+	}
+
+	std::cout << "robots:" << settings.robotNum << "  cameras per robot:" << settings.cameraNum << " " << settings.cameraWidth << "x" << settings.cameraHeight << " at " << settings.cameraRate << " Hz"
+	          << "  tf links:" << settings.tfLinkNum << " at " << settings.tfRate << " Hz  " << settings.duration << " s" << std::endl;
+
+	isSending = true;
+
+	ros::WallTime startTime = ros::WallTime::now();
+
+	boost::thread_group sendingThreads;
+
+	for(int i=0; i<settings.robotNum; i++)
+	{
+		sendingThreads.create_thread(boost::bind(&sendFrames, i, socketFds[i], boost::cref(settings)));
+	}
+
+	ros::WallDuration(settings.duration).sleep();
+
+	isSending = false;
+	sendingThreads.join_all();
+
+	double elapsed = (ros::WallTime::now() - startTime).toSec();
+
+	// The lists still on their way
+	ros::WallDuration(1.0).sleep();
+	spinner.stop();
+
+	for(size_t i=0; i<socketFds.size(); i++){ close(socketFds[i]); }
+
+	std::vector<double> latencies;
+	{
+		boost::mutex::scoped_lock lock(latencyMutex);
+		latencies.swap(tfLatencies);
+	}
+
+	std::cout << "camera frames sent:" << sentCameraFrameNum << "  tf lists sent:" << sentTfListNum << "  received:" << latencies.size() << std::endl;
+
+	// A received rate below the sent rate means that the bridge or the subscriber falls behind
+	std::cout << std::fixed << std::setprecision(0)
+	          << "transforms/s  sent:" << sentTransformNum / elapsed << "  received:" << receivedTransformNum / elapsed
+	          << "  lost:" << sentTransformNum - receivedTransformNum << std::endl;
+
+	if(latencies.empty()){ return 1; }
+
+	std::sort(latencies.begin(), latencies.end());
+
+	size_t n = latencies.size();
+
+	std::cout << std::fixed << std::setprecision(2)
+	          << "tf latency  p50:" << latencies[n/2]      << " ms"
+	          << "  p90:"           << latencies[n*9/10]   << " ms"
+	          << "  p99:"           << latencies[n*99/100] << " ms"
+	          << "  max:"           << latencies[n-1]      << " ms" << std::endl;
+
+	return 0;
+}
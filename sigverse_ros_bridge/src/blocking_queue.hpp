@@ -0,0 +1,95 @@
+#ifndef SIGVERSE_BLOCKING_QUEUE_HPP
+#define SIGVERSE_BLOCKING_QUEUE_HPP
+
+#include <deque>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+/**
+ * Queue for handing items over between threads.
+ */
+template < class ItemType >
+class BlockingQueue
+{
+private:
+	boost::mutex mutex;
+	boost::condition_variable condition;
+
+	std::deque<ItemType> items;
+
+	bool isClosed;
+
+public:
+	BlockingQueue() : isClosed(false) {}
+
+	void push(const ItemType &item)
+	{
+		{
+			boost::mutex::scoped_lock lock(mutex);
+			items.push_back(item);
+		}
+
+		condition.notify_one();
+	}
+
+	bool tryPop(ItemType &item)
+	{
+		boost::mutex::scoped_lock lock(mutex);
+
+		if(items.empty()){ return false; }
+
+		item = items.front();
+		items.pop_front();
+
+		return true;
+	}
+
+	// Waits for an item. Returns false when the queue is closed and empty.
+	bool pop(ItemType &item)
+	{
+		boost::mutex::scoped_lock lock(mutex);
+
+		while(items.empty() && !isClosed)
+		{
+			condition.wait(lock);
+		}
+
+		if(items.empty()){ return false; }
+
+		item = items.front();
+		items.pop_front();
+
+		return true;
+	}
+
+	// Waits for items and moves all of them to destItems. Returns false when the queue is closed and empty.
+	bool popAll(std::deque<ItemType> &destItems)
+	{
+		boost::mutex::scoped_lock lock(mutex);
+
+		while(items.empty() && !isClosed)
+		{
+			condition.wait(lock);
+		}
+
+		if(items.empty()){ return false; }
+
+		destItems.insert(destItems.end(), items.begin(), items.end());
+		items.clear();
+
+		return true;
+	}
+
+	void close()
+	{
+		{
+			boost::mutex::scoped_lock lock(mutex);
+			isClosed = true;
+		}
+
+		condition.notify_all();
+	}
+};
+
+#endif // SIGVERSE_BLOCKING_QUEUE_HPP
@@ -0,0 +1,136 @@
+#include "clock_sync.hpp"
+
+#include <cmath>
+
+void ClockSync::addOneWaySample(const ros::Time &t1, const ros::Time &t2)
+{
+	Sample sample;
+	sample.rosTime = t2;
+	sample.offset  = (t2 - t1).toSec();
+	sample.delay   = 0.0; // Unknown. It is included in the offset.
+
+	addSample(sample, false);
+}
+
+void ClockSync::addRoundTripSample(const ros::Time &t1, const ros::Time &t2, const ros::Time &t3, const ros::Time &t4)
+{
+	Sample sample;
+	sample.rosTime = t3;
+	sample.offset  = ((t2 - t1).toSec() + (t3 - t4).toSec()) / 2.0;
+	sample.delay   = std::max(0.0, (t4 - t1).toSec() - (t3 - t2).toSec());
+
+	addSample(sample, true);
+}
+
+void ClockSync::addSample(const Sample &sample, bool isRoundTrip)
+{
+	boost::mutex::scoped_lock lock(mutex);
+
+	// One-way samples are biased by the delay. Once the client answers exchanges, they are not used any more.
+	if(quality.isRoundTrip && !isRoundTrip){ return; }
+
+	if(isRoundTrip && !quality.isRoundTrip)
+	{
+		window .clear();
+		history.clear();
+		quality.isRoundTrip = true;
+	}
+
+	window.push_back(sample);
+
+	if(window.size() > CLOCK_SYNC_WINDOW_SIZE){ window.pop_front(); }
+
+	// The sample with the least delay. One-way samples with the least offset have the least delay.
+	const Sample *best = &window[0];
+
+	for(size_t i=1; i<window.size(); i++)
+	{
+		double key     = isRoundTrip ? window[i].delay : window[i].offset;
+		double bestKey = isRoundTrip ? best->delay     : best->offset;
+
+		if(key < bestKey){ best = &window[i]; }
+	}
+
+	double squareSum = 0.0;
+
+	for(size_t i=0; i<window.size(); i++)
+	{
+		squareSum += (window[i].offset - best->offset) * (window[i].offset - best->offset);
+	}
+
+	// The same sample stays the best for a while. It goes into the history once.
+	if(history.empty() || history.back().rosTime != best->rosTime)
+	{
+		history.push_back(*best);
+
+		if(history.size() > CLOCK_SYNC_HISTORY_SIZE){ history.pop_front(); }
+	}
+
+	double drift = 0.0;
+
+	if(history.size() >= 2)
+	{
+		// Least squares of offset = a + drift * t, with t relative to the first sample for precision
+		double sumT = 0.0, sumO = 0.0, sumTT = 0.0, sumTO = 0.0;
+
+		for(size_t i=0; i<history.size(); i++)
+		{
+			double t = (history[i].rosTime - history.front().rosTime).toSec();
+			double o = history[i].offset;
+
+			sumT += t; sumO += o; sumTT += t*t; sumTO += t*o;
+		}
+
+		double n           = (double)history.size();
+		double denominator = n*sumTT - sumT*sumT;
+
+		if(denominator > 0.0){ drift = (n*sumTO - sumT*sumO) / denominator; }
+	}
+
+	quality.isSynchronized = true;
+	quality.offset         = best->offset;
+	quality.drift          = drift * 1.0e6;
+	quality.delay          = best->delay;
+	quality.jitter         = std::sqrt(squareSum / window.size());
+	quality.sampleNum++;
+
+	offsetTime = best->rosTime;
+}
+
+ClockQuality ClockSync::getQuality() const
+{
+	boost::mutex::scoped_lock lock(mutex);
+
+	return quality;
+}
+
+ClockConversion ClockSync::getConversion() const
+{
+	boost::mutex::scoped_lock lock(mutex);
+
+	ClockConversion conversion;
+
+	conversion.isValid    = quality.isSynchronized;
+	conversion.offset     = quality.offset;
+	conversion.drift      = quality.drift * 1.0e-6;
+	conversion.offsetTime = offsetTime;
+
+	return conversion;
+}
+
+bool ClockConversion::toRosTime(ros::Time &time) const
+{
+	if(!isValid || time.isZero()){ return false; }
+
+	// The drift applies to the ROS time elapsed since the offset was taken. The simulator time is moved into ROS time
+	// first, since the two clocks may be far apart.
+	double elapsed    = time.toSec() + offset - offsetTime.toSec();
+	double timeOffset = offset + drift * elapsed;
+
+	// Simulator times before the ROS epoch are left as they are
+	if(time.toSec() + timeOffset < 0.0){ return false; }
+
+	time += ros::Duration(timeOffset);
+
+	return true;
+}
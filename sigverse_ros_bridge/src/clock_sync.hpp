@@ -0,0 +1,85 @@
+#ifndef SIGVERSE_CLOCK_SYNC_HPP
+#define SIGVERSE_CLOCK_SYNC_HPP
+
+#include <deque>
+
+#include <ros/ros.h>
+#include <boost/thread.hpp>
+
+#define CLOCK_SYNC_WINDOW_SIZE   8  // Samples among which the one with the least delay is chosen
+#define CLOCK_SYNC_HISTORY_SIZE 32  // Chosen offsets used for the drift estimation
+
+/**
+ * Quality of a clock offset estimate.
+ */
+struct ClockQuality
+{
+	bool     isSynchronized;
+	bool     isRoundTrip;  // Estimated from NTP-style exchanges. Otherwise from one-way samples, which include the network delay.
+	double   offset;       // [sec] ROS time minus simulator time
+	double   drift;        // [ppm] Rate of change of the offset
+	double   delay;        // [sec] Round-trip delay of the chosen sample
+	double   jitter;       // [sec] RMS deviation of the samples in the window from the chosen offset
+	uint64_t sampleNum;
+
+	ClockQuality() : isSynchronized(false), isRoundTrip(false), offset(0.0), drift(0.0), delay(0.0), jitter(0.0), sampleNum(0) {}
+};
+
+/**
+ * Snapshot of an offset estimate, to convert many stamps without locking.
+ */
+struct ClockConversion
+{
+	bool      isValid;
+	double    offset; // [sec] At offsetTime
+	double    drift;  // [sec/sec]
+	ros::Time offsetTime; // ROS time
+
+	ClockConversion() : isValid(false), offset(0.0), drift(0.0) {}
+
+	// Converts a simulator time into ROS time, including the drift since the offset was taken.
+	// Returns false and leaves the time as it is if there is no estimate or the time is zero (not set).
+	bool toRosTime(ros::Time &time) const;
+};
+
+/**
+ * Estimates the offset and the drift of the simulator clock against ROS time, in the way of the NTP clock filter.
+ *
+ * In an NTP-style exchange, the simulator sends at t1, the bridge receives at t2 and replies at t3, and the simulator
+ * receives the reply at t4. Then the offset is ((t2-t1) + (t3-t4)) / 2 within half of the round-trip delay
+ * (t4-t1) - (t3-t2). Of the latest samples, the one with the least delay is used. Clients that send only t1 give
+ * one-way samples t2-t1, which are the offset plus the network delay, and the smallest of them is used.
+ *
+ * The drift is the least-squares slope of the chosen offsets over time.
+ *
+ * Thread-safe. Samples come from the control lane, and the estimate is read wherever stamps are corrected.
+ */
+class ClockSync
+{
+private:
+	struct Sample
+	{
+		ros::Time rosTime; // When the sample was taken
+		double    offset;
+		double    delay;
+	};
+
+	mutable boost::mutex mutex;
+
+	std::deque<Sample> window;
+	std::deque<Sample> history;
+
+	ClockQuality quality;
+	ros::Time    offsetTime; // When the chosen offset was taken
+
+	void addSample(const Sample &sample, bool isRoundTrip);
+
+public:
+	void addOneWaySample  (const ros::Time &t1, const ros::Time &t2);
+	void addRoundTripSample(const ros::Time &t1, const ros::Time &t2, const ros::Time &t3, const ros::Time &t4);
+
+	ClockQuality    getQuality() const;
+	ClockConversion getConversion() const;
+};
+
+#endif // SIGVERSE_CLOCK_SYNC_HPP
@@ -0,0 +1,321 @@
+#include "depth_conversion.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string.h>
+
+#include <sensor_msgs/image_encodings.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define POINT_STEP 16 // x, y, z and padding, so that a point is one SSE register
+#define MILLIMETER 0.001f
+
+CameraModel::CameraModel(const sensor_msgs::CameraInfo &cameraInfo)
+	: width(cameraInfo.width), height(cameraInfo.height),
+	  fx(cameraInfo.P[0]), fy(cameraInfo.P[5]), cx(cameraInfo.P[2]), cy(cameraInfo.P[6])
+{
+	// An uncalibrated camera has no P
+	if(std::count(cameraInfo.P.begin(), cameraInfo.P.end(), 0.0) == (long)cameraInfo.P.size())
+	{
+		fx = cameraInfo.K[0];
+		fy = cameraInfo.K[4];
+		cx = cameraInfo.K[2];
+		cy = cameraInfo.K[5];
+	}
+}
+
+bool CameraModel::operator==(const CameraModel &other) const
+{
+	return width==other.width && height==other.height && fx==other.fx && fy==other.fy && cx==other.cx && cy==other.cy;
+}
+
+
+void DepthCloudProjector::setCameraModel(const CameraModel &cameraModel)
+{
+	if(cameraModel == this->cameraModel){ return; }
+
+	this->cameraModel = cameraModel;
+
+	rayXs.resize(cameraModel.width);
+	rayYs.resize(cameraModel.height);
+
+	for(uint32_t u=0; u<cameraModel.width; u++)
+	{
+		rayXs[u] = (float)(((double)u - cameraModel.cx) / cameraModel.fx);
+	}
+
+	for(uint32_t v=0; v<cameraModel.height; v++)
+	{
+		rayYs[v] = (float)(((double)v - cameraModel.cy) / cameraModel.fy);
+	}
+}
+
+// Projects a row of depths in meters
+static void projectRow(const float *depths, const float *rayXs, float rayY, float *points, uint32_t width)
+{
+	const float badPoint = std::numeric_limits<float>::quiet_NaN();
+
+	uint32_t u = 0;
+
+#ifdef __SSE2__
+	const __m128 zero    = _mm_setzero_ps();
+	const __m128 nan     = _mm_set1_ps(badPoint);
+	const __m128 rayYVec = _mm_set1_ps(rayY);
+
+	for(; u+4 <= width; u+=4)
+	{
+		__m128 depth = _mm_loadu_ps(depths + u);
+
+		// Zero and NaN are invalid
+		__m128 isValid = _mm_cmpgt_ps(depth, zero);
+		depth = _mm_or_ps(_mm_and_ps(isValid, depth), _mm_andnot_ps(isValid, nan));
+
+		__m128 x = _mm_mul_ps(depth, _mm_loadu_ps(rayXs + u));
+		__m128 y = _mm_mul_ps(depth, rayYVec);
+		__m128 z = depth;
+		__m128 w = zero;
+
+		// Four columns of x, y and z into four points
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+
+		_mm_storeu_ps(points + 4*u,      x);
+		_mm_storeu_ps(points + 4*u + 4,  y);
+		_mm_storeu_ps(points + 4*u + 8,  z);
+		_mm_storeu_ps(points + 4*u + 12, w);
+	}
+#endif
+
+	for(; u<width; u++)
+	{
+		float depth = depths[u];
+
+		if(!(depth > 0.0f)){ depth = badPoint; }
+
+		points[4*u]   = depth * rayXs[u];
+		points[4*u+1] = depth * rayY;
+		points[4*u+2] = depth;
+		points[4*u+3] = 0.0f;
+	}
+}
+
+// Converts a row of 16UC1 depths into meters
+static void convertRow(const uint16_t *depths, float *meters, uint32_t width)
+{
+	uint32_t u = 0;
+
+#ifdef __SSE2__
+	const __m128i zero  = _mm_setzero_si128();
+	const __m128  scale = _mm_set1_ps(MILLIMETER);
+
+	for(; u+8 <= width; u+=8)
+	{
+		__m128i depth = _mm_loadu_si128((const __m128i *)(depths + u));
+
+		_mm_storeu_ps(meters + u,     _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(depth, zero)), scale));
+		_mm_storeu_ps(meters + u + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(depth, zero)), scale));
+	}
+#endif
+
+	for(; u<width; u++)
+	{
+		meters[u] = (float)depths[u] * MILLIMETER;
+	}
+}
+
+// Checks the encoding and the layout of a depth image
+static bool getDepthFormat(const sensor_msgs::Image &depth, bool &isShort)
+{
+	bool isFloat = (depth.encoding == sensor_msgs::image_encodings::TYPE_32FC1);
+	isShort      = (depth.encoding == sensor_msgs::image_encodings::TYPE_16UC1 || depth.encoding == sensor_msgs::image_encodings::MONO16);
+
+	if(!isFloat && !isShort){ return false; }
+
+	size_t pixelSize = isFloat ? sizeof(float) : sizeof(uint16_t);
+
+	return !depth.is_bigendian && depth.step >= depth.width * pixelSize && depth.data.size() >= (size_t)depth.step * depth.height;
+}
+
+// A row of a depth image in meters. A 16UC1 row is converted into the buffer.
+static const float *getDepthRow(const sensor_msgs::Image &depth, uint32_t v, bool isShort, std::vector<float> &meterRow)
+{
+	const uint8_t *row = &depth.data[(size_t)v * depth.step];
+
+	if(!isShort){ return (const float *)row; }
+
+	meterRow.resize(depth.width);
+	convertRow((const uint16_t *)row, &meterRow[0], depth.width);
+
+	return &meterRow[0];
+}
+
+bool DepthCloudProjector::project(const sensor_msgs::Image &depth, sensor_msgs::PointCloud2 &cloud)
+{
+	if(!cameraModel.isValid() || depth.width != cameraModel.width || depth.height != cameraModel.height){ return false; }
+
+	bool isShort;
+
+	if(!getDepthFormat(depth, isShort)){ return false; }
+
+	cloud.header       = depth.header;
+	cloud.height       = depth.height;
+	cloud.width        = depth.width;
+	cloud.is_bigendian = false;
+	cloud.is_dense     = false;
+	cloud.point_step   = POINT_STEP;
+	cloud.row_step     = POINT_STEP * depth.width;
+
+	if(cloud.fields.size() != 3)
+	{
+		const char *names[3] = { "x", "y", "z" };
+
+		cloud.fields.resize(3);
+
+		for(int i=0; i<3; i++)
+		{
+			cloud.fields[i].name     = names[i];
+			cloud.fields[i].offset   = i * sizeof(float);
+			cloud.fields[i].datatype = sensor_msgs::PointField::FLOAT32;
+			cloud.fields[i].count    = 1;
+		}
+	}
+
+	cloud.data.resize((size_t)cloud.row_step * cloud.height);
+
+	for(uint32_t v=0; v<depth.height; v++)
+	{
+		float *points = (float *)&cloud.data[(size_t)v * cloud.row_step];
+
+		projectRow(getDepthRow(depth, v, isShort, meterRow), &rayXs[0], rayYs[v], points, depth.width);
+	}
+
+	return true;
+}
+
+
+bool DepthScanSettings::operator==(const DepthScanSettings &other) const
+{
+	return scanHeight==other.scanHeight && rangeMin==other.rangeMin && rangeMax==other.rangeMax && scanTime==other.scanTime;
+}
+
+
+void DepthScanConverter::setCameraModel(const CameraModel &cameraModel, const DepthScanSettings &settings)
+{
+	if(cameraModel == this->cameraModel && settings == this->settings){ return; }
+
+	this->cameraModel = cameraModel;
+	this->settings    = settings;
+
+	uint32_t width = cameraModel.width;
+
+	scanIndices .resize(width);
+	rangeFactors.resize(width);
+	depthMins   .resize(width);
+	depthMaxs   .resize(width);
+
+	if(width < 2){ return; }
+
+	// Columns from left to right are bins from the largest angle to the smallest, around the z axis of the scan frame
+	double angleMin = -std::atan(((double)(width-1) - cameraModel.cx) / cameraModel.fx);
+	double angleMax = -std::atan((0.0               - cameraModel.cx) / cameraModel.fx);
+	double angleIncrement = (angleMax - angleMin) / (double)(width-1);
+
+	for(uint32_t u=0; u<width; u++)
+	{
+		double rayX  = ((double)u - cameraModel.cx) / cameraModel.fx;
+		double angle = -std::atan(rayX);
+
+		long index = std::lround((angle - angleMin) / angleIncrement);
+
+		scanIndices[u]  = (uint32_t)std::min(std::max(index, 0L), (long)width-1);
+		rangeFactors[u] = (float)std::sqrt(1.0 + rayX * rayX);
+		depthMins[u]    = (float)(settings.rangeMin / rangeFactors[u]);
+		depthMaxs[u]    = (float)(settings.rangeMax / rangeFactors[u]);
+	}
+
+	this->angleMin       = (float)angleMin;
+	this->angleMax       = (float)angleMax;
+	this->angleIncrement = (float)angleIncrement;
+}
+
+// Keeps the nearest valid depth of each column
+static void reduceRow(const float *depths, const float *depthMins, const float *depthMaxs, float *nearestDepths, uint32_t width)
+{
+	uint32_t u = 0;
+
+#ifdef __SSE2__
+	const __m128 zero     = _mm_setzero_ps();
+	const __m128 infinity = _mm_set1_ps(std::numeric_limits<float>::infinity());
+
+	for(; u+4 <= width; u+=4)
+	{
+		__m128 depth = _mm_loadu_ps(depths + u);
+
+		// Comparisons with NaN are false
+		__m128 isValid = _mm_and_ps(_mm_cmpgt_ps(depth, zero),
+		                 _mm_and_ps(_mm_cmpge_ps(depth, _mm_loadu_ps(depthMins + u)), _mm_cmple_ps(depth, _mm_loadu_ps(depthMaxs + u))));
+
+		depth = _mm_or_ps(_mm_and_ps(isValid, depth), _mm_andnot_ps(isValid, infinity));
+
+		_mm_storeu_ps(nearestDepths + u, _mm_min_ps(_mm_loadu_ps(nearestDepths + u), depth));
+	}
+#endif
+
+	for(; u<width; u++)
+	{
+		float depth = depths[u];
+
+		if(depth > 0.0f && depth >= depthMins[u] && depth <= depthMaxs[u] && depth < nearestDepths[u])
+		{
+			nearestDepths[u] = depth;
+		}
+	}
+}
+
+bool DepthScanConverter::convert(const sensor_msgs::Image &depth, sensor_msgs::LaserScan &scan)
+{
+	if(!cameraModel.isValid() || depth.width != cameraModel.width || depth.height != cameraModel.height || depth.width < 2){ return false; }
+
+	bool isShort;
+
+	if(!getDepthFormat(depth, isShort)){ return false; }
+
+	scan.header          = depth.header;
+	scan.angle_min       = angleMin;
+	scan.angle_max       = angleMax;
+	scan.angle_increment = angleIncrement;
+	scan.time_increment  = 0.0f;
+	scan.scan_time       = (float)settings.scanTime;
+	scan.range_min       = (float)settings.rangeMin;
+	scan.range_max       = (float)settings.rangeMax;
+	scan.intensities.clear();
+
+	// Rows around the optical center
+	int scanHeight = std::min(std::max(settings.scanHeight, 1), (int)depth.height);
+	int firstRow   = std::min(std::max((int)cameraModel.cy - scanHeight/2, 0), (int)depth.height - scanHeight);
+
+	nearestDepths.assign(depth.width, std::numeric_limits<float>::infinity());
+
+	for(int v=firstRow; v<firstRow+scanHeight; v++)
+	{
+		reduceRow(getDepthRow(depth, (uint32_t)v, isShort, meterRow), &depthMins[0], &depthMaxs[0], &nearestDepths[0], depth.width);
+	}
+
+	scan.ranges.assign(depth.width, std::numeric_limits<float>::quiet_NaN());
+
+	for(uint32_t u=0; u<depth.width; u++)
+	{
+		if(std::isinf(nearestDepths[u])){ continue; }
+
+		float range = nearestDepths[u] * rangeFactors[u];
+		float &bin  = scan.ranges[scanIndices[u]];
+
+		// Two columns may fall into one bin
+		if(std::isnan(bin) || range < bin){ bin = range; }
+	}
+
+	return true;
+}
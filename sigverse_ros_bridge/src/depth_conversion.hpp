@@ -0,0 +1,114 @@
+#ifndef SIGVERSE_DEPTH_CONVERSION_HPP
+#define SIGVERSE_DEPTH_CONVERSION_HPP
+
+#include <vector>
+
+#include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/PointCloud2.h>
+
+/**
+ * Pinhole intrinsics of a camera, taken from the P of its camera info as image_geometry::PinholeCameraModel does,
+ * or from the K if the P is all zeros.
+ */
+struct CameraModel
+{
+	uint32_t width;
+	uint32_t height;
+	double   fx, fy, cx, cy;
+
+	CameraModel() : width(0), height(0), fx(0.0), fy(0.0), cx(0.0), cy(0.0) {}
+
+	explicit CameraModel(const sensor_msgs::CameraInfo &cameraInfo);
+
+	bool isValid() const { return width > 0 && height > 0 && fx != 0.0 && fy != 0.0; }
+
+	bool operator==(const CameraModel &other) const;
+	bool operator!=(const CameraModel &other) const { return !(*this == other); }
+};
+
+/**
+ * Projects depth images (32FC1 in meters or 16UC1 in millimeters) into organized point clouds of x, y and z,
+ * in the same way as depth_image_proc/point_cloud_xyz.
+ *
+ * The rays (u - cx) / fx and (v - cy) / fy are computed once per camera model, so a point costs two multiplications.
+ * Four points at a time are projected with SSE2 where available. A depth that is zero or NaN gives a NaN point.
+ *
+ * Not thread-safe. Each depth topic has its own projector.
+ */
+class DepthCloudProjector
+{
+private:
+	CameraModel cameraModel;
+
+	std::vector<float> rayXs; // Per column
+	std::vector<float> rayYs; // Per row
+
+	std::vector<float> meterRow; // A row of a 16UC1 image converted into meters
+
+public:
+	// Rebuilds the ray tables if the model has changed
+	void setCameraModel(const CameraModel &cameraModel);
+
+	// Returns false if the encoding is not supported or the size does not match the camera model.
+	// The cloud may be a recycled message. Its data keeps the capacity.
+	bool project(const sensor_msgs::Image &depth, sensor_msgs::PointCloud2 &cloud);
+};
+
+/**
+ * Settings of a laser scan extracted from depth images.
+ */
+struct DepthScanSettings
+{
+	int    scanHeight; // Rows around the optical center of which the nearest depth is taken per column
+	double rangeMin;   // [m]
+	double rangeMax;   // [m]
+	double scanTime;   // [sec]
+
+	DepthScanSettings() : scanHeight(1), rangeMin(0.45), rangeMax(10.0), scanTime(1.0/30.0) {}
+
+	bool operator==(const DepthScanSettings &other) const;
+};
+
+/**
+ * Extracts laser scans from depth images in the same way as depthimage_to_laserscan.
+ *
+ * For each column, the nearest depth within the range limits among the scan rows is taken, and its range is the depth
+ * times sqrt(1 + ((u - cx) / fx)^2). The scan bin, the range factor and the depth limits of each column are computed
+ * once per camera model, and the rows are reduced four columns at a time with SSE2 where available.
+ * A bin without a valid depth is NaN.
+ *
+ * Not thread-safe. Each depth topic has its own converter.
+ */
+class DepthScanConverter
+{
+private:
+	CameraModel       cameraModel;
+	DepthScanSettings settings;
+
+	float angleMin;
+	float angleMax;
+	float angleIncrement;
+
+	// Per column
+	std::vector<uint32_t> scanIndices;  // Bin of the column in the scan
+	std::vector<float>    rangeFactors; // Range per depth
+	std::vector<float>    depthMins;    // Depth limits corresponding to the range limits
+	std::vector<float>    depthMaxs;
+
+	std::vector<float> nearestDepths; // Per column
+	std::vector<float> meterRow;      // A row of a 16UC1 image converted into meters
+
+public:
+	DepthScanConverter() : angleMin(0.0f), angleMax(0.0f), angleIncrement(0.0f) {}
+
+	// Rebuilds the tables if the model or the settings have changed
+	void setCameraModel(const CameraModel &cameraModel, const DepthScanSettings &settings);
+
+	// Returns false if the encoding is not supported or the size does not match the camera model.
+	// The scan may be a recycled message. The frame id is left to the caller.
+	bool convert(const sensor_msgs::Image &depth, sensor_msgs::LaserScan &scan);
+};
+
+#endif // SIGVERSE_DEPTH_CONVERSION_HPP
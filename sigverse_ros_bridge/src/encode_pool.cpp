@@ -0,0 +1,70 @@
+#include "encode_pool.hpp"
+
+EncodePool::EncodePool(int workerNum, size_t maxQueuedNum, const boost::function<void (int)> &workerInitializer)
+	: maxQueuedNum(maxQueuedNum), isRunning(true), workerInitializer(workerInitializer)
+{
+	if(workerNum < 1){ workerNum = 1; }
+	if(this->maxQueuedNum < 1){ this->maxQueuedNum = 1; }
+
+	for(int i=0; i<workerNum; i++)
+	{
+		threads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&EncodePool::work, this, i))));
+	}
+}
+
+EncodePool::~EncodePool()
+{
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		isRunning = false;
+		jobs.clear();
+	}
+
+	condition.notify_all();
+
+	for(size_t i=0; i<threads.size(); i++)
+	{
+		threads[i]->join();
+	}
+}
+
+bool EncodePool::trySubmit(const boost::function<void ()> &job)
+{
+	{
+		boost::mutex::scoped_lock lock(mutex);
+
+		if(!isRunning || jobs.size() >= maxQueuedNum){ return false; }
+
+		jobs.push_back(job);
+	}
+
+	condition.notify_one();
+
+	return true;
+}
+
+void EncodePool::work(int workerIndex)
+{
+	if(workerInitializer){ workerInitializer(workerIndex); }
+
+	while(true)
+	{
+		boost::function<void ()> job;
+
+		{
+			boost::mutex::scoped_lock lock(mutex);
+
+			while(isRunning && jobs.empty())
+			{
+				condition.wait(lock);
+			}
+
+			if(!isRunning){ break; }
+
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		job();
+	}
+}
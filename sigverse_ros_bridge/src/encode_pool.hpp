@@ -0,0 +1,45 @@
+#ifndef SIGVERSE_ENCODE_POOL_HPP
+#define SIGVERSE_ENCODE_POOL_HPP
+
+#include <deque>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+/**
+ * Thread pool for jobs that may be skipped, such as compressing images for remote viewers.
+ *
+ * At most maxQueuedNum jobs wait for a worker. When they are all waiting, a new job is refused at once instead of
+ * blocking the caller, so that the decode pool never waits for an encoder. Jobs still waiting at destruction are
+ * discarded.
+ */
+class EncodePool
+{
+private:
+	std::vector<boost::shared_ptr<boost::thread> > threads;
+
+	boost::mutex                          mutex;
+	boost::condition_variable             condition;
+	std::deque<boost::function<void ()> > jobs;
+
+	size_t maxQueuedNum;
+	bool   isRunning;
+
+	boost::function<void (int)> workerInitializer;
+
+	void work(int workerIndex);
+
+public:
+	// The initializer is called in each worker thread with its index before it runs any job
+	EncodePool(int workerNum, size_t maxQueuedNum, const boost::function<void (int)> &workerInitializer = boost::function<void (int)>());
+	~EncodePool();
+
+	// Returns false without queuing the job if maxQueuedNum jobs are already waiting
+	bool trySubmit(const boost::function<void ()> &job);
+
+	int getWorkerNum() const { return (int)threads.size(); }
+};
+
+#endif // SIGVERSE_ENCODE_POOL_HPP
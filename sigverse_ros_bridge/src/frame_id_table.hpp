@@ -0,0 +1,49 @@
+#ifndef SIGVERSE_FRAME_ID_TABLE_HPP
+#define SIGVERSE_FRAME_ID_TABLE_HPP
+
+#include <string>
+#include <unordered_map>
+
+#define MAX_FRAME_ID_NUM 4096 // The table is cleared when it grows beyond this
+
+/**
+ * Interns frame ids received from the simulator together with their prefixed form.
+ *
+ * A frame id is prefixed once when it is seen first, and the prebuilt string is returned for the same raw name after
+ * that. Neither the lookup nor the assignment of the result to a recycled message allocates.
+ *
+ * The table is not thread-safe. It belongs to a topic and is used only by the thread that processes the topic.
+ */
+class FrameIdTable
+{
+public:
+	explicit FrameIdTable(const std::string &prefix = std::string()) : prefix(prefix) {}
+
+	void setPrefix(const std::string &prefix)
+	{
+		this->prefix = prefix;
+		prefixedFrameIds.clear();
+	}
+
+	const std::string &get(const char *rawFrameId, size_t size)
+	{
+		lookupKey.assign(rawFrameId, size);
+
+		std::unordered_map<std::string, std::string>::const_iterator itr = prefixedFrameIds.find(lookupKey);
+
+		if(itr != prefixedFrameIds.end()){ return itr->second; }
+
+		if(prefixedFrameIds.size() >= MAX_FRAME_ID_NUM){ prefixedFrameIds.clear(); }
+
+		return prefixedFrameIds.insert(std::make_pair(lookupKey, prefix + lookupKey)).first->second;
+	}
+
+private:
+	std::string prefix;
+
+	std::unordered_map<std::string, std::string> prefixedFrameIds;
+
+	std::string lookupKey; // Reused, so that looking up does not allocate
+};
+
+#endif // SIGVERSE_FRAME_ID_TABLE_HPP
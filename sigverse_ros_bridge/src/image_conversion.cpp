@@ -0,0 +1,395 @@
+#include "image_conversion.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string.h>
+
+#include <sensor_msgs/image_encodings.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define HAS_SSSE3_KERNELS
+#endif
+
+#define MILLIMETERS_PER_METER 1000.0f
+#define MAX_SHORT_DEPTH       65535.0f
+
+enum DepthFormat
+{
+	DEPTH_NONE,
+	DEPTH_FLOAT, // 32FC1 [m]
+	DEPTH_SHORT, // 16UC1 [mm]
+};
+
+// Output channel c of a pixel is input channel order[c]
+struct ChannelShuffle
+{
+	int srcChannelNum;
+	int dstChannelNum;
+	int order[4];
+};
+
+static int getChannelNum(const std::string &encoding)
+{
+	if(encoding == sensor_msgs::image_encodings::RGB8  || encoding == sensor_msgs::image_encodings::BGR8) { return 3; }
+	if(encoding == sensor_msgs::image_encodings::RGBA8 || encoding == sensor_msgs::image_encodings::BGRA8){ return 4; }
+
+	return 0;
+}
+
+static bool isBgr(const std::string &encoding)
+{
+	return encoding == sensor_msgs::image_encodings::BGR8 || encoding == sensor_msgs::image_encodings::BGRA8;
+}
+
+static bool getChannelShuffle(const std::string &srcEncoding, const std::string &dstEncoding, ChannelShuffle &shuffle)
+{
+	shuffle.srcChannelNum = getChannelNum(srcEncoding);
+	shuffle.dstChannelNum = getChannelNum(dstEncoding);
+
+	// An alpha channel is dropped but never added
+	if(shuffle.srcChannelNum == 0 || shuffle.dstChannelNum == 0 || shuffle.dstChannelNum > shuffle.srcChannelNum){ return false; }
+
+	bool isSwapped = (isBgr(srcEncoding) != isBgr(dstEncoding));
+
+	for(int c=0; c<3; c++)
+	{
+		shuffle.order[c] = isSwapped ? 2-c : c;
+	}
+
+	shuffle.order[3] = 3;
+
+	return true;
+}
+
+static void shuffleRow(const uint8_t *src, uint8_t *dst, uint32_t firstPixel, uint32_t width, const ChannelShuffle &shuffle)
+{
+	for(uint32_t u=firstPixel; u<width; u++)
+	{
+		const uint8_t *srcPixel = src + u * shuffle.srcChannelNum;
+		uint8_t       *dstPixel = dst + u * shuffle.dstChannelNum;
+
+		for(int c=0; c<shuffle.dstChannelNum; c++)
+		{
+			dstPixel[c] = srcPixel[shuffle.order[c]];
+		}
+	}
+}
+
+static DepthFormat getDepthFormat(const std::string &encoding)
+{
+	if(encoding == sensor_msgs::image_encodings::TYPE_32FC1){ return DEPTH_FLOAT; }
+	if(encoding == sensor_msgs::image_encodings::TYPE_16UC1 || encoding == sensor_msgs::image_encodings::MONO16){ return DEPTH_SHORT; }
+
+	return DEPTH_NONE;
+}
+
+static bool isHostBigEndian()
+{
+	const uint16_t one = 1;
+	return *(const uint8_t *)&one == 0;
+}
+
+static float readFloat(const uint8_t *src, bool isSwapped)
+{
+	uint32_t bits;
+	memcpy(&bits, src, sizeof(bits));
+
+	if(isSwapped){ bits = __builtin_bswap32(bits); }
+
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static uint16_t readShort(const uint8_t *src, bool isSwapped)
+{
+	uint16_t value;
+	memcpy(&value, src, sizeof(value));
+
+	return isSwapped ? __builtin_bswap16(value) : value;
+}
+
+static uint16_t toShortDepth(float meters)
+{
+	float millimeters = meters * MILLIMETERS_PER_METER;
+
+	// NaN fails both
+	if(!(millimeters >= 0.0f && millimeters <= MAX_SHORT_DEPTH)){ return 0; }
+
+	return (uint16_t)std::lrint(millimeters); // To nearest even as the SSE conversion
+}
+
+static float toFloatDepth(uint16_t millimeters)
+{
+	if(millimeters == 0){ return std::numeric_limits<float>::quiet_NaN(); }
+
+	return (float)millimeters / MILLIMETERS_PER_METER;
+}
+
+static void convertDepthRow(const uint8_t *src, uint8_t *dst, uint32_t firstPixel, uint32_t width, DepthFormat srcFormat, DepthFormat dstFormat, bool isSwapped)
+{
+	for(uint32_t u=firstPixel; u<width; u++)
+	{
+		if(srcFormat == DEPTH_FLOAT)
+		{
+			float depth = readFloat(src + u * sizeof(float), isSwapped);
+
+			if(dstFormat == DEPTH_FLOAT){ memcpy(dst + u * sizeof(float), &depth, sizeof(depth)); }
+			else
+			{
+				uint16_t shortDepth = toShortDepth(depth);
+				memcpy(dst + u * sizeof(uint16_t), &shortDepth, sizeof(shortDepth));
+			}
+		}
+		else
+		{
+			uint16_t depth = readShort(src + u * sizeof(uint16_t), isSwapped);
+
+			if(dstFormat == DEPTH_SHORT){ memcpy(dst + u * sizeof(uint16_t), &depth, sizeof(depth)); }
+			else
+			{
+				float floatDepth = toFloatDepth(depth);
+				memcpy(dst + u * sizeof(float), &floatDepth, sizeof(floatDepth));
+			}
+		}
+	}
+}
+
+#ifdef HAS_SSSE3_KERNELS
+static bool hasSsse3()
+{
+	static const bool isSupported = __builtin_cpu_supports("ssse3");
+	return isSupported;
+}
+
+// Shuffles the pixels of a row that fit in whole 16-byte loads and stores. Returns the number of pixels done.
+__attribute__((target("ssse3")))
+static uint32_t shuffleRowSsse3(const uint8_t *src, uint8_t *dst, uint32_t width, const ChannelShuffle &shuffle)
+{
+	uint32_t blockPixelNum = 16 / shuffle.srcChannelNum; // 4 of rgba8 or 5 of rgb8
+
+	int8_t maskBytes[16];
+	memset(maskBytes, 0x80, sizeof(maskBytes)); // Zeroes the unused output bytes
+
+	for(uint32_t p=0; p<blockPixelNum; p++)
+	{
+		for(int c=0; c<shuffle.dstChannelNum; c++)
+		{
+			maskBytes[p * shuffle.dstChannelNum + c] = (int8_t)(p * shuffle.srcChannelNum + shuffle.order[c]);
+		}
+	}
+
+	const __m128i mask = _mm_loadu_si128((const __m128i *)maskBytes);
+
+	uint32_t u = 0;
+
+	// Neither the load nor the store may run past the row
+	while(u + blockPixelNum <= width && (u * shuffle.srcChannelNum + 16) <= width * shuffle.srcChannelNum
+	                                 && (u * shuffle.dstChannelNum + 16) <= width * shuffle.dstChannelNum)
+	{
+		__m128i pixels = _mm_loadu_si128((const __m128i *)(src + u * shuffle.srcChannelNum));
+
+		_mm_storeu_si128((__m128i *)(dst + u * shuffle.dstChannelNum), _mm_shuffle_epi8(pixels, mask));
+
+		u += blockPixelNum;
+	}
+
+	return u;
+}
+
+// Converts the depths of a row 8 at a time. Returns the number of pixels done.
+__attribute__((target("ssse3")))
+static uint32_t convertDepthRowSsse3(const uint8_t *src, uint8_t *dst, uint32_t width, DepthFormat srcFormat, DepthFormat dstFormat, bool isSwapped)
+{
+	const __m128i swap32 = _mm_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12);
+	const __m128i swap16 = _mm_setr_epi8(1,0, 3,2, 5,4, 7,6, 9,8, 11,10, 13,12, 15,14);
+
+	const __m128  zero        = _mm_setzero_ps();
+	const __m128  nan         = _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+	const __m128  maxShort    = _mm_set1_ps(MAX_SHORT_DEPTH);
+	const __m128  millimeters = _mm_set1_ps(MILLIMETERS_PER_METER);
+	const __m128  meters      = _mm_set1_ps(1.0f / MILLIMETERS_PER_METER);
+	const __m128i signBias32  = _mm_set1_epi32(0x8000);
+	const __m128i signBias16  = _mm_set1_epi16((short)0x8000);
+
+	uint32_t u = 0;
+
+	for(; u+8 <= width; u+=8)
+	{
+		if(srcFormat == DEPTH_FLOAT)
+		{
+			__m128i lowBits  = _mm_loadu_si128((const __m128i *)(src + u * sizeof(float)));
+			__m128i highBits = _mm_loadu_si128((const __m128i *)(src + u * sizeof(float) + 16));
+
+			if(isSwapped)
+			{
+				lowBits  = _mm_shuffle_epi8(lowBits,  swap32);
+				highBits = _mm_shuffle_epi8(highBits, swap32);
+			}
+
+			if(dstFormat == DEPTH_FLOAT)
+			{
+				_mm_storeu_si128((__m128i *)(dst + u * sizeof(float)),      lowBits);
+				_mm_storeu_si128((__m128i *)(dst + u * sizeof(float) + 16), highBits);
+				continue;
+			}
+
+			__m128 lowDepth  = _mm_mul_ps(_mm_castsi128_ps(lowBits),  millimeters);
+			__m128 highDepth = _mm_mul_ps(_mm_castsi128_ps(highBits), millimeters);
+
+			// Out of range and NaN (compared false) become 0
+			__m128 isLowValid  = _mm_and_ps(_mm_cmpge_ps(lowDepth,  zero), _mm_cmple_ps(lowDepth,  maxShort));
+			__m128 isHighValid = _mm_and_ps(_mm_cmpge_ps(highDepth, zero), _mm_cmple_ps(highDepth, maxShort));
+
+			__m128i lowShort  = _mm_and_si128(_mm_castps_si128(isLowValid),  _mm_cvtps_epi32(_mm_and_ps(isLowValid,  lowDepth)));
+			__m128i highShort = _mm_and_si128(_mm_castps_si128(isHighValid), _mm_cvtps_epi32(_mm_and_ps(isHighValid, highDepth)));
+
+			// Unsigned 16-bit packing with the signed saturation of SSE2
+			__m128i packed = _mm_packs_epi32(_mm_sub_epi32(lowShort, signBias32), _mm_sub_epi32(highShort, signBias32));
+
+			_mm_storeu_si128((__m128i *)(dst + u * sizeof(uint16_t)), _mm_add_epi16(packed, signBias16));
+		}
+		else
+		{
+			__m128i depth = _mm_loadu_si128((const __m128i *)(src + u * sizeof(uint16_t)));
+
+			if(isSwapped){ depth = _mm_shuffle_epi8(depth, swap16); }
+
+			if(dstFormat == DEPTH_SHORT)
+			{
+				_mm_storeu_si128((__m128i *)(dst + u * sizeof(uint16_t)), depth);
+				continue;
+			}
+
+			__m128 lowDepth  = _mm_cvtepi32_ps(_mm_unpacklo_epi16(depth, _mm_setzero_si128()));
+			__m128 highDepth = _mm_cvtepi32_ps(_mm_unpackhi_epi16(depth, _mm_setzero_si128()));
+
+			// 0 is invalid
+			__m128 isLowZero  = _mm_cmpeq_ps(lowDepth,  zero);
+			__m128 isHighZero = _mm_cmpeq_ps(highDepth, zero);
+
+			lowDepth  = _mm_or_ps(_mm_andnot_ps(isLowZero,  _mm_mul_ps(lowDepth,  meters)), _mm_and_ps(isLowZero,  nan));
+			highDepth = _mm_or_ps(_mm_andnot_ps(isHighZero, _mm_mul_ps(highDepth, meters)), _mm_and_ps(isHighZero, nan));
+
+			_mm_storeu_ps((float *)(dst + u * sizeof(float)),     lowDepth);
+			_mm_storeu_ps((float *)(dst + u * sizeof(float) + 16), highDepth);
+		}
+	}
+
+	return u;
+}
+#endif
+
+bool copyImageData(const uint8_t *data, size_t size, const ImageTransform &transform, sensor_msgs::Image &image)
+{
+	uint32_t height  = image.height;
+	uint32_t srcStep = image.step;
+
+	bool isSameEncoding = (transform.encoding.empty() || transform.encoding == image.encoding);
+
+	DepthFormat srcDepthFormat = getDepthFormat(image.encoding);
+	DepthFormat dstDepthFormat = transform.encoding.empty() ? DEPTH_NONE : getDepthFormat(transform.encoding);
+
+	bool isDepthSwapped = ((image.is_bigendian != 0) != isHostBigEndian());
+
+	size_t srcPixelSize = (srcDepthFormat == DEPTH_FLOAT) ? sizeof(float) : sizeof(uint16_t);
+
+	// A depth encoding requested explicitly is always delivered in the byte order of the host
+	bool isDepthConverted = srcDepthFormat != DEPTH_NONE && dstDepthFormat != DEPTH_NONE && (srcDepthFormat != dstDepthFormat || isDepthSwapped)
+	                        && srcStep >= image.width * srcPixelSize && size >= (size_t)srcStep * height;
+
+	if(isDepthConverted)
+	{
+		size_t   dstPixelSize = (dstDepthFormat == DEPTH_FLOAT) ? sizeof(float) : sizeof(uint16_t);
+		uint32_t dstStep      = image.width * dstPixelSize;
+
+		image.data.resize((size_t)dstStep * height);
+
+#ifdef HAS_SSSE3_KERNELS
+		bool useSsse3 = hasSsse3();
+#endif
+
+		for(uint32_t v=0; v<height; v++)
+		{
+			const uint8_t *srcRow = data + (size_t)(transform.flipVertical ? height-1-v : v) * srcStep;
+			uint8_t       *dstRow = &image.data[(size_t)v * dstStep];
+
+			uint32_t u = 0;
+
+#ifdef HAS_SSSE3_KERNELS
+			if(useSsse3){ u = convertDepthRowSsse3(srcRow, dstRow, image.width, srcDepthFormat, dstDepthFormat, isDepthSwapped); }
+#endif
+
+			convertDepthRow(srcRow, dstRow, u, image.width, srcDepthFormat, dstDepthFormat, isDepthSwapped);
+		}
+
+		image.encoding     = transform.encoding;
+		image.is_bigendian = isHostBigEndian();
+		image.step         = dstStep;
+
+		return true;
+	}
+
+	// Same depth encoding in the byte order of the host
+	if(srcDepthFormat != DEPTH_NONE && srcDepthFormat == dstDepthFormat){ isSameEncoding = true; }
+
+	ChannelShuffle shuffle;
+
+	bool isShuffled = !isSameEncoding && getChannelShuffle(image.encoding, transform.encoding, shuffle)
+	                  && srcStep >= image.width * shuffle.srcChannelNum && size >= (size_t)srcStep * height;
+
+	if(!isShuffled)
+	{
+		size_t dataSize = std::min(size, (size_t)srcStep * height);
+
+		image.data.resize(dataSize);
+
+		if(dataSize == 0){ return isSameEncoding; }
+
+		if(!transform.flipVertical || dataSize < (size_t)srcStep * height)
+		{
+			memcpy(&image.data[0], data, dataSize);
+		}
+		else
+		{
+			for(uint32_t v=0; v<height; v++)
+			{
+				memcpy(&image.data[(size_t)v * srcStep], data + (size_t)(height-1-v) * srcStep, srcStep);
+			}
+		}
+
+		// e.g. mono16 published as 16UC1
+		if(isSameEncoding && !transform.encoding.empty()){ image.encoding = transform.encoding; }
+
+		return isSameEncoding;
+	}
+
+	uint32_t dstStep = image.width * shuffle.dstChannelNum;
+
+	image.data.resize((size_t)dstStep * height);
+
+#ifdef HAS_SSSE3_KERNELS
+	bool useSsse3 = hasSsse3();
+#endif
+
+	for(uint32_t v=0; v<height; v++)
+	{
+		const uint8_t *srcRow = data + (size_t)(transform.flipVertical ? height-1-v : v) * srcStep;
+		uint8_t       *dstRow = &image.data[(size_t)v * dstStep];
+
+		uint32_t u = 0;
+
+#ifdef HAS_SSSE3_KERNELS
+		if(useSsse3){ u = shuffleRowSsse3(srcRow, dstRow, image.width, shuffle); }
+#endif
+
+		shuffleRow(srcRow, dstRow, u, image.width, shuffle);
+	}
+
+	image.encoding = transform.encoding;
+	image.step     = dstStep;
+
+	return true;
+}
@@ -0,0 +1,27 @@
+#ifndef SIGVERSE_IMAGE_CONVERSION_HPP
+#define SIGVERSE_IMAGE_CONVERSION_HPP
+
+#include <sensor_msgs/Image.h>
+
+#include "image_transform.hpp"
+
+/**
+ * Copies the pixels of a received image into the message, converting them on the way, so that the conversion costs
+ * no extra pass over the image.
+ *
+ * The image has the received height, width, encoding, is_bigendian and step set, and they are updated to the output.
+ * Supported conversions are
+ *
+ *   - the vertical flip,
+ *   - the channel orders among rgb8, bgr8, rgba8 and bgra8 (swapping red and blue, dropping the alpha),
+ *   - the depth encodings 32FC1 [m] and 16UC1 [mm] (mono16 is taken as 16UC1), also into the same one. The output is in
+ *     the byte order of the host. Zero and NaN are the invalid depths of 16UC1 and 32FC1 respectively, and a depth
+ *     out of the range of 16UC1 becomes 0.
+ *
+ * Pixels are processed with SSSE3 when the CPU supports it.
+ *
+ * Returns false if the encodings cannot be converted. The pixels are then copied as they are, flipped if requested.
+ */
+bool copyImageData(const uint8_t *data, size_t size, const ImageTransform &transform, sensor_msgs::Image &image);
+
+#endif // SIGVERSE_IMAGE_CONVERSION_HPP
@@ -0,0 +1,132 @@
+#include "image_pyramid.hpp"
+
+#include <string.h>
+
+#include <sensor_msgs/image_encodings.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define HAS_SSSE3_KERNELS
+#endif
+
+static int getChannelNum(const std::string &encoding)
+{
+	if(encoding == sensor_msgs::image_encodings::MONO8 || encoding == sensor_msgs::image_encodings::TYPE_8UC1){ return 1; }
+	if(encoding == sensor_msgs::image_encodings::RGB8  || encoding == sensor_msgs::image_encodings::BGR8  || encoding == sensor_msgs::image_encodings::TYPE_8UC3){ return 3; }
+	if(encoding == sensor_msgs::image_encodings::RGBA8 || encoding == sensor_msgs::image_encodings::BGRA8 || encoding == sensor_msgs::image_encodings::TYPE_8UC4){ return 4; }
+
+	return 0;
+}
+
+static inline uint8_t average(uint8_t a, uint8_t b)
+{
+	return (uint8_t)(((unsigned)a + (unsigned)b + 1) >> 1);
+}
+
+static void downscaleRow(const uint8_t *upperRow, const uint8_t *lowerRow, uint8_t *dstRow, uint32_t firstPixel, uint32_t dstWidth, int channelNum)
+{
+	for(uint32_t u=firstPixel; u<dstWidth; u++)
+	{
+		const uint8_t *upper = upperRow + 2 * u * channelNum;
+		const uint8_t *lower = lowerRow + 2 * u * channelNum;
+
+		for(int c=0; c<channelNum; c++)
+		{
+			dstRow[u * channelNum + c] = average(average(upper[c], lower[c]), average(upper[channelNum + c], lower[channelNum + c]));
+		}
+	}
+}
+
+#ifdef HAS_SSSE3_KERNELS
+static bool hasSsse3()
+{
+	static const bool isSupported = __builtin_cpu_supports("ssse3");
+	return isSupported;
+}
+
+// Downscales the pixels of a row that fit in whole 16-byte loads and 8-byte stores. Returns the number of pixels done.
+__attribute__((target("ssse3")))
+static uint32_t downscaleRowSsse3(const uint8_t *upperRow, const uint8_t *lowerRow, uint8_t *dstRow, uint32_t dstWidth, int channelNum)
+{
+	// Output pixels per block: 8 of 1 channel, 2 of 3 or 4 channels
+	uint32_t blockPixelNum = (channelNum == 1) ? 8 : 2;
+
+	// Picks the first pixel of every pair
+	int8_t maskBytes[16];
+	memset(maskBytes, 0x80, sizeof(maskBytes));
+
+	for(uint32_t p=0; p<blockPixelNum; p++)
+	{
+		for(int c=0; c<channelNum; c++)
+		{
+			maskBytes[p * channelNum + c] = (int8_t)(2 * p * channelNum + c);
+		}
+	}
+
+	const __m128i mask = _mm_loadu_si128((const __m128i *)maskBytes);
+
+	uint32_t srcRowSize = 2 * dstWidth * channelNum;
+	uint32_t dstRowSize = dstWidth * channelNum;
+
+	uint32_t u = 0;
+
+	while(u + blockPixelNum <= dstWidth && 2 * u * channelNum + 16 <= srcRowSize && u * channelNum + 8 <= dstRowSize)
+	{
+		__m128i upper = _mm_loadu_si128((const __m128i *)(upperRow + 2 * u * channelNum));
+		__m128i lower = _mm_loadu_si128((const __m128i *)(lowerRow + 2 * u * channelNum));
+
+		__m128i vertical = _mm_avg_epu8(upper, lower);
+
+		// Pixel p with pixel p+1 at the position of pixel p
+		__m128i next = (channelNum == 1) ? _mm_srli_si128(vertical, 1) : (channelNum == 3) ? _mm_srli_si128(vertical, 3) : _mm_srli_si128(vertical, 4);
+
+		__m128i pixels = _mm_shuffle_epi8(_mm_avg_epu8(vertical, next), mask);
+
+		_mm_storel_epi64((__m128i *)(dstRow + u * channelNum), pixels);
+
+		u += blockPixelNum;
+	}
+
+	return u;
+}
+#endif
+
+bool downscaleImage(const sensor_msgs::Image &src, sensor_msgs::Image &dst)
+{
+	int channelNum = getChannelNum(src.encoding);
+
+	if(channelNum == 0 || src.step < src.width * channelNum || src.data.size() < (size_t)src.step * src.height){ return false; }
+
+	// Nothing is left of an image narrower or lower than 2 pixels
+	if(src.width < 2 || src.height < 2){ return false; }
+
+	dst.header       = src.header;
+	dst.height       = src.height / 2;
+	dst.width        = src.width  / 2;
+	dst.encoding     = src.encoding;
+	dst.is_bigendian = src.is_bigendian;
+	dst.step         = dst.width * channelNum;
+
+	dst.data.resize((size_t)dst.step * dst.height);
+
+#ifdef HAS_SSSE3_KERNELS
+	bool useSsse3 = hasSsse3();
+#endif
+
+	for(uint32_t v=0; v<dst.height; v++)
+	{
+		const uint8_t *upperRow = &src.data[(size_t)(2*v)   * src.step];
+		const uint8_t *lowerRow = &src.data[(size_t)(2*v+1) * src.step];
+		uint8_t       *dstRow   = &dst.data[(size_t)v * dst.step];
+
+		uint32_t u = 0;
+
+#ifdef HAS_SSSE3_KERNELS
+		if(useSsse3){ u = downscaleRowSsse3(upperRow, lowerRow, dstRow, dst.width, channelNum); }
+#endif
+
+		downscaleRow(upperRow, lowerRow, dstRow, u, dst.width, channelNum);
+	}
+
+	return true;
+}
@@ -0,0 +1,17 @@
+#ifndef SIGVERSE_IMAGE_PYRAMID_HPP
+#define SIGVERSE_IMAGE_PYRAMID_HPP
+
+#include <sensor_msgs/Image.h>
+
+/**
+ * Halves an image with a 2x2 box filter. Odd last rows and columns are dropped.
+ *
+ * 8-bit images of 1, 3 or 4 channels (mono8, rgb8, bgr8, rgba8, bgra8, 8UC1, 8UC3 and 8UC4) are supported.
+ * A pixel is the rounded mean of the two rows, then of the two columns, which is within one level of the exact mean.
+ * Processed with SSSE3 when the CPU supports it.
+ *
+ * Returns false if the encoding is not supported or the image is narrower or lower than 2 pixels. The output may be a recycled message. Its data keeps the capacity.
+ */
+bool downscaleImage(const sensor_msgs::Image &src, sensor_msgs::Image &dst);
+
+#endif // SIGVERSE_IMAGE_PYRAMID_HPP
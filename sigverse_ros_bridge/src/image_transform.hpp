@@ -0,0 +1,19 @@
+#ifndef SIGVERSE_IMAGE_TRANSFORM_HPP
+#define SIGVERSE_IMAGE_TRANSFORM_HPP
+
+#include <string>
+
+/**
+ * Conversion of a received image into what the subscribers of its topic expect.
+ */
+struct ImageTransform
+{
+	bool        flipVertical; // Unity renders bottom-up
+	std::string encoding;     // Published encoding. Empty means the received one.
+
+	ImageTransform() : flipVertical(false) {}
+
+	bool isIdentity() const { return !flipVertical && encoding.empty(); }
+};
+
+#endif // SIGVERSE_IMAGE_TRANSFORM_HPP
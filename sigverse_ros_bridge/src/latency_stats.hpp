@@ -0,0 +1,75 @@
+#ifndef SIGVERSE_LATENCY_STATS_HPP
+#define SIGVERSE_LATENCY_STATS_HPP
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#define LATENCY_SAMPLE_MAX_NUM 4096
+
+/**
+ * Collects latency samples and prints their percentiles.
+ * At most LATENCY_SAMPLE_MAX_NUM samples are kept between reports, chosen uniformly at random (reservoir sampling).
+ * The maximum and the number of samples are exact.
+ */
+class LatencyStats
+{
+private:
+	std::vector<double> samples; //[ms]
+	size_t              sampleNum;
+	double              maxSample;
+	std::minstd_rand    random;
+
+	double getPercentile(double percent)
+	{
+		size_t index = (size_t)((samples.size() - 1) * percent / 100.0);
+
+		std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+
+		return samples[index];
+	}
+
+public:
+	LatencyStats() : sampleNum(0), maxSample(0.0)
+	{
+		samples.reserve(LATENCY_SAMPLE_MAX_NUM);
+	}
+
+	void add(double latencyMsec)
+	{
+		sampleNum++;
+
+		if(sampleNum==1 || latencyMsec > maxSample){ maxSample = latencyMsec; }
+
+		if(samples.size() < LATENCY_SAMPLE_MAX_NUM)
+		{
+			samples.push_back(latencyMsec);
+			return;
+		}
+
+		// Every sample stays with the probability LATENCY_SAMPLE_MAX_NUM / sampleNum
+		size_t index = (size_t)(random() % sampleNum);
+
+		if(index < LATENCY_SAMPLE_MAX_NUM){ samples[index] = latencyMsec; }
+	}
+
+	// Prints the percentiles of the samples since the last report
+	void report(const std::string &name)
+	{
+		if(samples.empty()){ return; }
+
+		double p50 = getPercentile(50.0);
+		double p90 = getPercentile(90.0);
+		double p99 = getPercentile(99.0);
+
+		std::cout << "Latency[ms] " << name << " p50=" << p50 << " p90=" << p90 << " p99=" << p99 << " max=" << maxSample << " n=" << sampleNum << std::endl;
+
+		samples.clear();
+		sampleNum = 0;
+		maxSample = 0.0;
+	}
+};
+
+#endif // SIGVERSE_LATENCY_STATS_HPP
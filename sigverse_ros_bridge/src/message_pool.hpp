@@ -0,0 +1,63 @@
+#ifndef SIGVERSE_MESSAGE_POOL_HPP
+#define SIGVERSE_MESSAGE_POOL_HPP
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+
+#define DEFAULT_MESSAGE_POOL_SIZE 16
+
+/**
+ * Recycles published messages of one topic.
+ *
+ * A message handed out by acquire() goes back into circulation as soon as roscpp and all intra-process subscribers
+ * have dropped their references to it, i.e. when the pool holds the last one. The vectors in a recycled message keep
+ * their capacity, so refilling a message of the same size allocates nothing.
+ *
+ * The pool is not thread-safe. Each topic has its own pool which is used only by the thread that publishes the topic.
+ */
+template < class MessageType >
+class MessagePool
+{
+public:
+	typedef boost::shared_ptr<MessageType> MessagePtr;
+
+	explicit MessagePool(size_t maxPooledNum = DEFAULT_MESSAGE_POOL_SIZE)
+		: maxPooledNum(maxPooledNum), nextIndex(0)
+	{
+		messages.reserve(maxPooledNum);
+	}
+
+	MessagePtr acquire()
+	{
+		for(size_t i=0; i<messages.size(); i++)
+		{
+			size_t index = (nextIndex + i) % messages.size();
+
+			if(messages[index].use_count() == 1)
+			{
+				nextIndex = (index + 1) % messages.size();
+				return messages[index];
+			}
+		}
+
+		// Every pooled message is still in use (e.g. held by a slow subscriber)
+		MessagePtr message = boost::make_shared<MessageType>();
+
+		if(messages.size() < maxPooledNum)
+		{
+			messages.push_back(message);
+		}
+
+		return message;
+	}
+
+private:
+	size_t maxPooledNum;
+	size_t nextIndex;
+
+	std::vector<MessagePtr> messages;
+};
+
+#endif // SIGVERSE_MESSAGE_POOL_HPP
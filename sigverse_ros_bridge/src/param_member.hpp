@@ -0,0 +1,71 @@
+#ifndef SIGVERSE_PARAM_MEMBER_HPP
+#define SIGVERSE_PARAM_MEMBER_HPP
+
+#include <iostream>
+#include <string>
+
+#include <ros/ros.h>
+
+/**
+ * Members of a struct in a list parameter, e.g. an entry of topic_policies.
+ *
+ * The casts of XmlRpcValue throw XmlRpcException on a type mismatch (e.g. "latch: 1" or "queue_size: 10.0"), which
+ * would abort the nodelet, so the type is checked first. A missing member leaves the value as it is and is not an error.
+ * A member of another type is reported and false is returned, so that the caller can ignore the entry.
+ */
+inline bool isParamMemberOfType(XmlRpc::XmlRpcValue &structValue, const char *key, XmlRpc::XmlRpcValue::Type type, const char *typeName)
+{
+	if(structValue[key].getType() == type){ return true; }
+
+	std::cout << key << " must be " << typeName << "." << std::endl;
+	return false;
+}
+
+inline bool readParamMember(XmlRpc::XmlRpcValue &structValue, const char *key, bool &value)
+{
+	if(!structValue.hasMember(key)){ return true; }
+
+	if(!isParamMemberOfType(structValue, key, XmlRpc::XmlRpcValue::TypeBoolean, "true or false")){ return false; }
+
+	value = static_cast<bool>(structValue[key]);
+	return true;
+}
+
+inline bool readParamMember(XmlRpc::XmlRpcValue &structValue, const char *key, int &value)
+{
+	if(!structValue.hasMember(key)){ return true; }
+
+	if(!isParamMemberOfType(structValue, key, XmlRpc::XmlRpcValue::TypeInt, "an integer")){ return false; }
+
+	value = static_cast<int>(structValue[key]);
+	return true;
+}
+
+// Integers are also taken, e.g. "max_rate: 10"
+inline bool readParamMember(XmlRpc::XmlRpcValue &structValue, const char *key, double &value)
+{
+	if(!structValue.hasMember(key)){ return true; }
+
+	if(structValue[key].getType() == XmlRpc::XmlRpcValue::TypeInt)
+	{
+		value = (double)static_cast<int>(structValue[key]);
+		return true;
+	}
+
+	if(!isParamMemberOfType(structValue, key, XmlRpc::XmlRpcValue::TypeDouble, "a number")){ return false; }
+
+	value = static_cast<double>(structValue[key]);
+	return true;
+}
+
+inline bool readParamMember(XmlRpc::XmlRpcValue &structValue, const char *key, std::string &value)
+{
+	if(!structValue.hasMember(key)){ return true; }
+
+	if(!isParamMemberOfType(structValue, key, XmlRpc::XmlRpcValue::TypeString, "a string")){ return false; }
+
+	value = static_cast<std::string>(structValue[key]);
+	return true;
+}
+
+#endif // SIGVERSE_PARAM_MEMBER_HPP
@@ -0,0 +1,116 @@
+#include "scan_conversion.hpp"
+
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define POINT_STEP 16 // x, y, z and intensity
+
+void ScanCloudProjector::updateTables(const sensor_msgs::LaserScan &scan)
+{
+	if(scan.angle_min == angleMin && scan.angle_increment == angleIncrement && scan.ranges.size() == cosTable.size()){ return; }
+
+	angleMin       = scan.angle_min;
+	angleIncrement = scan.angle_increment;
+
+	cosTable.resize(scan.ranges.size());
+	sinTable.resize(scan.ranges.size());
+
+	for(size_t i=0; i<scan.ranges.size(); i++)
+	{
+		double angle = (double)scan.angle_min + (double)i * (double)scan.angle_increment;
+
+		cosTable[i] = (float)std::cos(angle);
+		sinTable[i] = (float)std::sin(angle);
+	}
+}
+
+// Appends a point if its range is valid
+static inline float *addPoint(float *point, float range, float rangeMin, float rangeMax, float x, float y, float intensity)
+{
+	if(!(range >= rangeMin && range <= rangeMax)){ return point; }
+
+	point[0] = x;
+	point[1] = y;
+	point[2] = 0.0f;
+	point[3] = intensity;
+
+	return point + 4;
+}
+
+void ScanCloudProjector::project(const sensor_msgs::LaserScan &scan, sensor_msgs::PointCloud2 &cloud)
+{
+	updateTables(scan);
+
+	size_t beamNum      = scan.ranges.size();
+	bool   hasIntensity = (scan.intensities.size() == beamNum);
+
+	cloud.header       = scan.header;
+	cloud.height       = 1;
+	cloud.is_bigendian = false;
+	cloud.is_dense     = true;
+	cloud.point_step   = POINT_STEP;
+
+	if(cloud.fields.size() != 4)
+	{
+		const char *names[4] = { "x", "y", "z", "intensity" };
+
+		cloud.fields.resize(4);
+
+		for(int i=0; i<4; i++)
+		{
+			cloud.fields[i].name     = names[i];
+			cloud.fields[i].offset   = i * sizeof(float);
+			cloud.fields[i].datatype = sensor_msgs::PointField::FLOAT32;
+			cloud.fields[i].count    = 1;
+		}
+	}
+
+	// Shrunk to the valid points below
+	cloud.data.resize(beamNum * POINT_STEP);
+
+	if(beamNum == 0)
+	{
+		cloud.width    = 0;
+		cloud.row_step = 0;
+		return;
+	}
+
+	const float *ranges      = &scan.ranges[0];
+	const float *intensities = hasIntensity ? &scan.intensities[0] : NULL;
+
+	float *firstPoint = (float *)&cloud.data[0];
+	float *point      = firstPoint;
+
+	size_t i = 0;
+
+#ifdef __SSE2__
+	for(; i+4 <= beamNum; i+=4)
+	{
+		__m128 range = _mm_loadu_ps(ranges + i);
+
+		float xs[4];
+		float ys[4];
+
+		_mm_storeu_ps(xs, _mm_mul_ps(range, _mm_loadu_ps(&cosTable[i])));
+		_mm_storeu_ps(ys, _mm_mul_ps(range, _mm_loadu_ps(&sinTable[i])));
+
+		for(int j=0; j<4; j++)
+		{
+			point = addPoint(point, ranges[i+j], scan.range_min, scan.range_max, xs[j], ys[j], hasIntensity ? intensities[i+j] : 0.0f);
+		}
+	}
+#endif
+
+	for(; i<beamNum; i++)
+	{
+		point = addPoint(point, ranges[i], scan.range_min, scan.range_max, ranges[i] * cosTable[i], ranges[i] * sinTable[i], hasIntensity ? intensities[i] : 0.0f);
+	}
+
+	cloud.width    = (uint32_t)((point - firstPoint) / 4);
+	cloud.row_step = cloud.width * POINT_STEP;
+
+	cloud.data.resize(cloud.row_step);
+}
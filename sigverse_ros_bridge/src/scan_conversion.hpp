@@ -0,0 +1,39 @@
+#ifndef SIGVERSE_SCAN_CONVERSION_HPP
+#define SIGVERSE_SCAN_CONVERSION_HPP
+
+#include <vector>
+
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/PointCloud2.h>
+
+/**
+ * Projects laser scans into point clouds in the frame of the scan, in the same way as
+ * laser_geometry::LaserProjection::projectLaser.
+ *
+ * Ranges outside [range_min, range_max] and NaN are dropped, so the cloud is unorganized (height 1) and dense.
+ * Each point is x, y, z and the intensity (0 if the scan has none).
+ *
+ * cos and sin of every beam are kept for the last (angle_min, angle_increment, size), so a point costs two
+ * multiplications. Four beams at a time are projected with SSE2 where available.
+ *
+ * Not thread-safe. Each scan topic has its own projector.
+ */
+class ScanCloudProjector
+{
+private:
+	float angleMin;
+	float angleIncrement;
+
+	std::vector<float> cosTable;
+	std::vector<float> sinTable;
+
+	void updateTables(const sensor_msgs::LaserScan &scan);
+
+public:
+	ScanCloudProjector() : angleMin(0.0f), angleIncrement(0.0f) {}
+
+	// The cloud may be a recycled message. Its data keeps the capacity.
+	void project(const sensor_msgs::LaserScan &scan, sensor_msgs::PointCloud2 &cloud);
+};
+
+#endif // SIGVERSE_SCAN_CONVERSION_HPP
@@ -0,0 +1,202 @@
+#include "sensor_output_table.hpp"
+
+#include <iostream>
+
+#include "param_member.hpp"
+
+void SensorOutputTable::load(const ros::NodeHandle &nodeHandle, const ros::NodeHandle &privateNodeHandle)
+{
+	loadClouds(nodeHandle, privateNodeHandle);
+	loadScans (nodeHandle, privateNodeHandle);
+	loadScanClouds(nodeHandle, privateNodeHandle);
+}
+
+void SensorOutputTable::loadClouds(const ros::NodeHandle &nodeHandle, const ros::NodeHandle &privateNodeHandle)
+{
+	cloudOutputs.clear();
+
+	XmlRpc::XmlRpcValue cloudList;
+
+	if(!privateNodeHandle.getParam("depth_clouds", cloudList)){ return; }
+
+	if(cloudList.getType() != XmlRpc::XmlRpcValue::TypeArray)
+	{
+		std::cout << "depth_clouds must be a list. Ignored." << std::endl;
+		return;
+	}
+
+	for(int i=0; i<cloudList.size(); i++)
+	{
+		XmlRpc::XmlRpcValue &cloudValue = cloudList[i];
+
+		if(cloudValue.getType() != XmlRpc::XmlRpcValue::TypeStruct ||
+		   !cloudValue.hasMember("depth") || !cloudValue.hasMember("camera_info") || !cloudValue.hasMember("points"))
+		{
+			std::cout << "depth_clouds[" << i << "] needs depth, camera_info and points. Ignored." << std::endl;
+			continue;
+		}
+
+		std::string depthTopic;
+		DepthCloudOutput cloudOutput;
+
+		bool isValid =
+			readParamMember(cloudValue, "depth",       depthTopic)                  &&
+			readParamMember(cloudValue, "camera_info", cloudOutput.cameraInfoTopic) &&
+			readParamMember(cloudValue, "points",      cloudOutput.pointsTopic);
+
+		if(!isValid)
+		{
+			std::cout << "depth_clouds[" << i << "] has a value of a wrong type. Ignored." << std::endl;
+			continue;
+		}
+
+		depthTopic                  = nodeHandle.resolveName(depthTopic);
+		cloudOutput.cameraInfoTopic = nodeHandle.resolveName(cloudOutput.cameraInfoTopic);
+		cloudOutput.pointsTopic     = nodeHandle.resolveName(cloudOutput.pointsTopic);
+
+		std::cout << "Depth cloud " << depthTopic << " + " << cloudOutput.cameraInfoTopic << " -> " << cloudOutput.pointsTopic << std::endl;
+
+		cloudOutputs[depthTopic] = cloudOutput;
+	}
+}
+
+const DepthCloudOutput *SensorOutputTable::getCloud(const std::string &resolvedDepthTopic) const
+{
+	std::map<std::string, DepthCloudOutput>::const_iterator itr = cloudOutputs.find(resolvedDepthTopic);
+
+	if(itr == cloudOutputs.end()){ return NULL; }
+
+	return &itr->second;
+}
+
+void SensorOutputTable::loadScans(const ros::NodeHandle &nodeHandle, const ros::NodeHandle &privateNodeHandle)
+{
+	scanOutputs.clear();
+
+	XmlRpc::XmlRpcValue scanList;
+
+	if(!privateNodeHandle.getParam("depth_scans", scanList)){ return; }
+
+	if(scanList.getType() != XmlRpc::XmlRpcValue::TypeArray)
+	{
+		std::cout << "depth_scans must be a list. Ignored." << std::endl;
+		return;
+	}
+
+	for(int i=0; i<scanList.size(); i++)
+	{
+		XmlRpc::XmlRpcValue &scanValue = scanList[i];
+
+		if(scanValue.getType() != XmlRpc::XmlRpcValue::TypeStruct ||
+		   !scanValue.hasMember("depth") || !scanValue.hasMember("camera_info") || !scanValue.hasMember("scan"))
+		{
+			std::cout << "depth_scans[" << i << "] needs depth, camera_info and scan. Ignored." << std::endl;
+			continue;
+		}
+
+		std::string depthTopic;
+		DepthScanOutput scanOutput;
+		scanOutput.frameId = "camera_depth_frame";
+
+		bool isValid =
+			readParamMember(scanValue, "depth",       depthTopic)                    &&
+			readParamMember(scanValue, "camera_info", scanOutput.cameraInfoTopic)    &&
+			readParamMember(scanValue, "scan",        scanOutput.scanTopic)          &&
+			readParamMember(scanValue, "frame_id",    scanOutput.frameId)            &&
+			readParamMember(scanValue, "scan_height", scanOutput.settings.scanHeight) &&
+			readParamMember(scanValue, "range_min",   scanOutput.settings.rangeMin)  &&
+			readParamMember(scanValue, "range_max",   scanOutput.settings.rangeMax)  &&
+			readParamMember(scanValue, "scan_time",   scanOutput.settings.scanTime);
+
+		if(!isValid)
+		{
+			std::cout << "depth_scans[" << i << "] has a value of a wrong type. Ignored." << std::endl;
+			continue;
+		}
+
+		depthTopic                 = nodeHandle.resolveName(depthTopic);
+		scanOutput.cameraInfoTopic = nodeHandle.resolveName(scanOutput.cameraInfoTopic);
+		scanOutput.scanTopic       = nodeHandle.resolveName(scanOutput.scanTopic);
+
+		std::cout << "Depth scan " << depthTopic << " + " << scanOutput.cameraInfoTopic << " -> " << scanOutput.scanTopic
+		          << " frame_id=" << scanOutput.frameId << " scan_height=" << scanOutput.settings.scanHeight
+		          << " range_min=" << scanOutput.settings.rangeMin << " range_max=" << scanOutput.settings.rangeMax << std::endl;
+
+		scanOutputs[depthTopic] = scanOutput;
+	}
+}
+
+const DepthScanOutput *SensorOutputTable::getScan(const std::string &resolvedDepthTopic) const
+{
+	std::map<std::string, DepthScanOutput>::const_iterator itr = scanOutputs.find(resolvedDepthTopic);
+
+	if(itr == scanOutputs.end()){ return NULL; }
+
+	return &itr->second;
+}
+
+void SensorOutputTable::loadScanClouds(const ros::NodeHandle &nodeHandle, const ros::NodeHandle &privateNodeHandle)
+{
+	scanCloudTopics.clear();
+
+	XmlRpc::XmlRpcValue cloudList;
+
+	if(!privateNodeHandle.getParam("scan_clouds", cloudList)){ return; }
+
+	if(cloudList.getType() != XmlRpc::XmlRpcValue::TypeArray)
+	{
+		std::cout << "scan_clouds must be a list. Ignored." << std::endl;
+		return;
+	}
+
+	for(int i=0; i<cloudList.size(); i++)
+	{
+		XmlRpc::XmlRpcValue &cloudValue = cloudList[i];
+
+		if(cloudValue.getType() != XmlRpc::XmlRpcValue::TypeStruct || !cloudValue.hasMember("scan") || !cloudValue.hasMember("points"))
+		{
+			std::cout << "scan_clouds[" << i << "] needs scan and points. Ignored." << std::endl;
+			continue;
+		}
+
+		std::string scanTopic;
+		std::string pointsTopic;
+
+		if(!readParamMember(cloudValue, "scan", scanTopic) || !readParamMember(cloudValue, "points", pointsTopic))
+		{
+			std::cout << "scan_clouds[" << i << "] has a value of a wrong type. Ignored." << std::endl;
+			continue;
+		}
+
+		scanTopic   = nodeHandle.resolveName(scanTopic);
+		pointsTopic = nodeHandle.resolveName(pointsTopic);
+
+		std::cout << "Scan cloud " << scanTopic << " -> " << pointsTopic << std::endl;
+
+		scanCloudTopics[scanTopic] = pointsTopic;
+	}
+}
+
+std::string SensorOutputTable::getScanCloudTopic(const std::string &resolvedScanTopic) const
+{
+	std::map<std::string, std::string>::const_iterator itr = scanCloudTopics.find(resolvedScanTopic);
+
+	if(itr == scanCloudTopics.end()){ return std::string(); }
+
+	return itr->second;
+}
+
+bool SensorOutputTable::isCameraInfoUsed(const std::string &resolvedCameraInfoTopic) const
+{
+	for(std::map<std::string, DepthCloudOutput>::const_iterator itr = cloudOutputs.begin(); itr != cloudOutputs.end(); ++itr)
+	{
+		if(itr->second.cameraInfoTopic == resolvedCameraInfoTopic){ return true; }
+	}
+
+	for(std::map<std::string, DepthScanOutput>::const_iterator itr = scanOutputs.begin(); itr != scanOutputs.end(); ++itr)
+	{
+		if(itr->second.cameraInfoTopic == resolvedCameraInfoTopic){ return true; }
+	}
+
+	return false;
+}
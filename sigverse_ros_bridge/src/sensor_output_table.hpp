@@ -0,0 +1,82 @@
+#ifndef SIGVERSE_SENSOR_OUTPUT_TABLE_HPP
+#define SIGVERSE_SENSOR_OUTPUT_TABLE_HPP
+
+#include <map>
+#include <string>
+
+#include <ros/ros.h>
+
+#include "depth_conversion.hpp"
+
+/**
+ * Organized point cloud projected from a depth image with the intrinsics of a camera info topic.
+ */
+struct DepthCloudOutput
+{
+	std::string cameraInfoTopic; // Resolved
+	std::string pointsTopic;     // Resolved
+};
+
+/**
+ * Laser scan extracted from the rows of a depth image around its optical center.
+ */
+struct DepthScanOutput
+{
+	std::string       cameraInfoTopic; // Resolved
+	std::string       scanTopic;       // Resolved
+	std::string       frameId;         // Of the scan, whose x axis is the optical axis
+	DepthScanSettings settings;
+};
+
+/**
+ * Outputs derived from sensor topics in the bridge, e.g.
+ *
+ *   depth_clouds:
+ *     - depth: "/camera/depth/image_raw"
+ *       camera_info: "/camera/depth/camera_info"
+ *       points: "/camera/depth/points"
+ *
+ *   depth_scans:
+ *     - depth: "/camera/depth/image_raw"
+ *       camera_info: "/camera/depth/camera_info"
+ *       scan: "/scan"
+ *       frame_id: "camera_depth_frame"
+ *       scan_height: 1
+ *       range_min: 0.45
+ *       range_max: 10.0
+ *       scan_time: 0.033
+ *
+ *   scan_clouds:
+ *     - scan: "/scan"
+ *       points: "/scan/points"
+ *
+ * Topic names are resolved when loaded and matched exactly.
+ */
+class SensorOutputTable
+{
+private:
+	std::map<std::string, DepthCloudOutput> cloudOutputs; // Keyed by resolved depth topic
+	std::map<std::string, DepthScanOutput>  scanOutputs;  // Keyed by resolved depth topic
+	std::map<std::string, std::string>      scanCloudTopics; // Resolved point cloud topics keyed by resolved scan topic
+
+	void loadClouds(const ros::NodeHandle &nodeHandle, const ros::NodeHandle &privateNodeHandle);
+	void loadScans (const ros::NodeHandle &nodeHandle, const ros::NodeHandle &privateNodeHandle);
+	void loadScanClouds(const ros::NodeHandle &nodeHandle, const ros::NodeHandle &privateNodeHandle);
+
+public:
+	void load(const ros::NodeHandle &nodeHandle, const ros::NodeHandle &privateNodeHandle);
+
+	// NULL if the topic has no point cloud output
+	const DepthCloudOutput *getCloud(const std::string &resolvedDepthTopic) const;
+
+	// NULL if the topic has no laser scan output
+	const DepthScanOutput *getScan(const std::string &resolvedDepthTopic) const;
+
+	// Empty if the scan topic has no point cloud output
+	std::string getScanCloudTopic(const std::string &resolvedScanTopic) const;
+
+	// Whether the intrinsics of the camera info topic are used by an output
+	bool isCameraInfoUsed(const std::string &resolvedCameraInfoTopic) const;
+};
+
+#endif // SIGVERSE_SENSOR_OUTPUT_TABLE_HPP
@@ -1,432 +1,1840 @@
 
 #include "sigverse_ros_bridge.hpp"
 
-bool SIGVerseROSBridge::isRunning;
-int  SIGVerseROSBridge::syncTimeCnt;
-int  SIGVerseROSBridge::syncTimeMaxNum;
+SIGVerseROSBridge::SIGVerseROSBridge(const ros::NodeHandle &nodeHandle, const ros::NodeHandle &privateNodeHandle, uint16_t portNumber, int syncTimeMaxNum)
+	: nodeHandle(nodeHandle), imageTransport(nodeHandle), portNumber(portNumber), isRunning(false), syncTimeCnt(0), syncTimeMaxNum(syncTimeMaxNum), epollFd(-1), wakeFd(-1)
+{
+	// Read once at startup and applied whenever a publisher is created
+	topicPolicyTable.load(privateNodeHandle);
+
+	privateNodeHandle.param("tf_prefix", tfPrefix, std::string(DEFAULT_TF_PREFIX));
+	privateNodeHandle.param("tf_static_frame_num", tfStaticFrameNum, 0);
+	privateNodeHandle.param("correct_stamps",      correctStamps,    false);
+	privateNodeHandle.param("publish_bundles",     publishBundles,   false);
+
+	privateNodeHandle.param("clock_reset_threshold", clockResetThreshold, DEFAULT_CLOCK_RESET_THRESHOLD);
+	clockDropNum = 0;
+
+	tfDeadbandTable.load(privateNodeHandle);
+
+	sensorOutputTable.load(this->nodeHandle, privateNodeHandle);
+
+	diagnosticsPublisher = this->nodeHandle.advertise<diagnostic_msgs::DiagnosticArray>(DIAGNOSTICS_TOPIC, DEFAULT_SENSOR_QUEUE_SIZE);
+
+	privateNodeHandle.param("priority_lanes",    usePriorityLanes, true);
+	privateNodeHandle.param("decode_worker_num", decodeWorkerNum,  (int)boost::thread::hardware_concurrency());
+	privateNodeHandle.param("report_latency",    reportLatency,    false);
+
+	if(decodeWorkerNum < 1){ decodeWorkerNum = 1; }
+
+	privateNodeHandle.param("encode_worker_num", encodeWorkerNum, DEFAULT_ENCODE_WORKER_NUM);
+	privateNodeHandle.param("encode_queue_size", encodeQueueSize, DEFAULT_ENCODE_QUEUE_SIZE);
+
+	listenerTuning.load(privateNodeHandle, "listener");
+	controlTuning .load(privateNodeHandle, "control");
+	decodeTuning  .load(privateNodeHandle, "decode");
+	encodeTuning  .load(privateNodeHandle, "encode");
+
+	bool lockBuffersParam;
+	privateNodeHandle.param("lock_buffers", lockBuffersParam, false);
+	lockBuffers = lockBuffersParam;
+
+	int frameBufferLimitMb;
+	privateNodeHandle.param("frame_buffer_limit", frameBufferLimitMb, DEFAULT_FRAME_BUFFER_LIMIT);
+	frameBufferLimit = (size_t)std::max(frameBufferLimitMb, 0) * 1024 * 1024;
+}
+
+pid_t SIGVerseROSBridge::gettid(void)
+{
+	return syscall(SYS_gettid);
+}
+
+
+void SIGVerseROSBridge::setVectorDouble(std::vector<double> &destVec, const bsoncxx::array::view &arrayView)
+{
+	int i = 0;
+
+	for(auto itr = arrayView.cbegin(); itr != arrayView.cend(); ++itr)
+	{
+		destVec[i++] = (*itr).get_double();
+	}
+}
+
+void SIGVerseROSBridge::setVectorFloat(std::vector<float> &destVec, const bsoncxx::array::view &arrayView)
+{
+	int i = 0;
+
+	for(auto itr = arrayView.cbegin(); itr != arrayView.cend(); ++itr)
+	{
+		destVec[i++] = (float)((*itr).get_double());
+	}
+}
+
+void SIGVerseROSBridge::setFrameId(std::string &frameId, const bsoncxx::document::element &element)
+{
+	bsoncxx::stdx::string_view frameIdView = element.get_utf8().value;
+
+	// The string of a recycled message keeps its capacity
+	frameId.assign(frameIdView.data(), frameIdView.size());
+}
+
+ros::Time SIGVerseROSBridge::getTime(const bsoncxx::document::element &element)
+{
+	return ros::Time((uint32_t)element["secs"].get_int32(), (uint32_t)element["nsecs"].get_int32());
+}
+
+uint64_t SIGVerseROSBridge::hashElements(const bsoncxx::document::view &documentView, const char *skippedKey)
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+
+	const uint8_t *data = documentView.data();
+
+	size_t elementOffset  = 0;
+	bool   isPrevSkipped  = true; // The length prefix is not hashed
+
+	for(auto itr = documentView.cbegin(); itr != documentView.cend(); ++itr)
+	{
+		size_t nextOffset = (*itr).offset();
+
+		if(!isPrevSkipped)
+		{
+			for(size_t i=elementOffset; i<nextOffset; i++){ hash = (hash ^ data[i]) * 1099511628211ULL; }
+		}
+
+		elementOffset = nextOffset;
+		isPrevSkipped = ((*itr).key() == skippedKey);
+	}
+
+	// Up to the terminating zero
+	if(!isPrevSkipped)
+	{
+		for(size_t i=elementOffset; i+1<documentView.length(); i++){ hash = (hash ^ data[i]) * 1099511628211ULL; }
+	}
+
+	return hash;
+}
+
+template < size_t ArrayNum >
+void SIGVerseROSBridge::setArrayDouble(boost::array<double, ArrayNum> &destArray, const bsoncxx::array::view &arrayView)
+{
+	int i = 0;
+
+	for(auto itr = arrayView.cbegin(); itr != arrayView.cend(); ++itr)
+	{
+		destArray[i++] = (*itr).get_double();
+	}
+}
+
+void SIGVerseROSBridge::acceptConnections(int srcSocket)
+{
+	while(true)
+	{
+		struct sockaddr_in dstAddr;
+		socklen_t dstAddrSize = sizeof(dstAddr);
+
+		int dstSocket = accept4(srcSocket, (struct sockaddr *)&dstAddr, &dstAddrSize, SOCK_NONBLOCK);
+
+		if(dstSocket == -1)
+		{
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			{
+				std::cout << "Can not accept. error=" << strerror(errno) << std::endl;
+			}
+			return;
+		}
+
+		std::cout << "Connected from IP=" << inet_ntoa(dstAddr.sin_addr) << " Port=" << dstAddr.sin_port << " fd=" << dstSocket << std::endl;
+
+		boost::shared_ptr<Connection> connection(new Connection(dstSocket));
+
+		connections[dstSocket] = connection;
+
+		struct epoll_event event;
+		event.events  = EPOLLIN;
+		event.data.fd = dstSocket;
+
+		epoll_ctl(epollFd, EPOLL_CTL_ADD, dstSocket, &event);
+	}
+}
+
+SIGVerseROSBridge::ReceiveResult SIGVerseROSBridge::readSocket(Connection &connection, uint8_t *buffer, size_t size)
+{
+	while(connection.receivedSize < size)
+	{
+		ssize_t receivedSize = read(connection.dstSocket, buffer + connection.receivedSize, size - connection.receivedSize);
+
+		if(receivedSize > 0)
+		{
+			connection.receivedSize += receivedSize;
+			continue;
+		}
+
+		if(receivedSize == 0)
+		{
+			std::cout << "Socket closed. fd=" << connection.dstSocket << std::endl;
+			return RECEIVE_CLOSED;
+		}
+
+		if(errno == EINTR){ continue; }
+
+		if(errno == EAGAIN || errno == EWOULDBLOCK){ return RECEIVE_INCOMPLETE; }
+
+		std::cout << "Socket error. fd=" << connection.dstSocket << " error=" << strerror(errno) << std::endl;
+		return RECEIVE_CLOSED;
+	}
+
+	return RECEIVE_OK;
+}
+
+bool SIGVerseROSBridge::handleReadable(Connection &connection)
+{
+	for(int i=0; i<REACTOR_FRAME_BUDGET && !connection.isReadPaused; i++)
+	{
+		if(connection.receiveState == RECEIVE_HEADER)
+		{
+			ReceiveResult receiveResult = readSocket(connection, (uint8_t *)connection.header, sizeof(connection.header));
+
+			if(receiveResult != RECEIVE_OK){ return receiveResult != RECEIVE_CLOSED; }
+
+			memcpy(&connection.msgSize, connection.header, sizeof(int32_t));
+
+			if(connection.msgSize > BUFFER_SIZE)
+			{
+				std::cout << "Data size is too big. fd=" << connection.dstSocket << std::endl;
+				return false;
+			}
+			if(connection.msgSize < (int32_t)sizeof(int32_t))
+			{
+				std::cout << "Data size is invalid. fd=" << connection.dstSocket << std::endl;
+				return false;
+			}
+
+			connection.receiveState = RECEIVE_BODY;
+		}
+
+		// A frame is taken only when its size is known, so that a connection waiting for a header holds no frame
+		if(connection.receivingFrame==NULL && !startFrame(connection)){ return true; }
+
+		ReceiveResult receiveResult = readSocket(connection, &connection.receivingFrame->buffer[0], (size_t)connection.msgSize);
+
+		if(receiveResult != RECEIVE_OK){ return receiveResult != RECEIVE_CLOSED; }
+
+		finishFrame(connection);
+	}
+
+	return true;
+}
+
+bool SIGVerseROSBridge::startFrame(Connection &connection)
+{
+	Frame *frame = acquireFrame(connection);
+
+	if(frame==NULL)
+	{
+		connection.isReadPaused = true;
+		updateEvents(connection);
+		return false;
+	}
+
+	size_t oldCapacity = frame->buffer.capacity();
+
+	// The buffer keeps its capacity, so frames of the same size are received without allocation
+	if(lockBuffers && (size_t)connection.msgSize > frame->buffer.capacity())
+	{
+		// The pages of the old buffer are unlocked when it is freed
+		frame->buffer.reserve(connection.msgSize);
+
+		if(!ThreadTuning::lockMemory(&frame->buffer[0], frame->buffer.capacity())){ lockBuffers = false; }
+	}
+
+	frame->buffer.resize(connection.msgSize);
+
+	connection.bufferCapacity += frame->buffer.capacity() - oldCapacity;
+	memcpy(&frame->buffer[0], connection.header, sizeof(int32_t));
+
+	connection.receivingFrame = frame;
+
+	return true;
+}
+
+void SIGVerseROSBridge::finishFrame(Connection &connection)
+{
+	Frame *frame = connection.receivingFrame;
+
+	connection.receivingFrame = NULL;
+	connection.receiveState   = RECEIVE_HEADER;
+	connection.receivedSize   = 0;
+
+	frame->bsonView = bsoncxx::document::view(&frame->buffer[0], frame->buffer.size());
+
+	bsoncxx::stdx::string_view topicView = frame->bsonView["topic"].get_utf8().value;
+	bsoncxx::stdx::string_view typeView  = frame->bsonView["type"] .get_utf8().value;
+
+	frame->topic.assign(topicView.data(), topicView.size());
+	frame->type .assign(typeView .data(), typeView .size());
+
+	frame->isSuperseded = false;
+
+	frame->receivedTime = ros::WallTime::now();
+
+	connection.lastReceivedTime = frame->receivedTime;
+
+	dispatchFrame(connection, frame);
+}
+
+void SIGVerseROSBridge::dispatchFrame(Connection &connection, Frame *frame)
+{
+	// Control and TF frames are processed in their own lane, so that they never wait behind camera frames.
+	// Without priority lanes, every frame goes through the control lane in arrival order.
+	if(!decodePool || isControlType(frame->type))
+	{
+		if(!connection.controlLane)
+		{
+			connection.controlLane.reset(new Lane("control"));
+			connection.controlLane->thread.reset(new boost::thread(boost::bind(&SIGVerseROSBridge::processLane, this, &connection, connection.controlLane.get())));
+		}
+
+		// Never blocks since the ring can hold every frame of the connection
+		connection.controlLane->frameRing.push(frame);
+	}
+	else if(frame->type==TYPE_SENSOR_BUNDLE)
+	{
+		dispatchBundle(connection, frame);
+	}
+	else
+	{
+		dispatchToStrand(connection, frame);
+	}
+}
+
+void SIGVerseROSBridge::dispatchBundle(Connection &connection, Frame *frame)
+{
+	// Each part goes to the strand of its topic like an individual message, so that its topic keeps one publisher,
+	// its order and its policy. The bundle message is built on the strand of the bundle topic after the parts.
+	Frame *parts[BUNDLE_PART_NUM];
+	int partNum = 0;
+
+	for(int i=0; i<BUNDLE_PART_NUM; i++)
+	{
+		boost::shared_ptr<Frame> &part = frame->bundleParts[i];
+
+		if(!part){ part.reset(new Frame()); }
+
+		if(getBundlePart(*frame, (BundlePart)i, *part)){ parts[partNum++] = part.get(); }
+	}
+
+	frame->bundleStrand = &getStrand(connection, frame->topic);
+
+	// Set before the first part is dispatched, since it may be finished before the next one is dispatched
+	frame->unfinishedPartNum = partNum;
+
+	if(partNum==0)
+	{
+		scheduleFrame(connection, *frame->bundleStrand, frame);
+		return;
+	}
+
+	for(int i=0; i<partNum; i++)
+	{
+		dispatchToStrand(connection, parts[i]);
+	}
+}
+
+bool SIGVerseROSBridge::getBundlePart(Frame &bundleFrame, BundlePart bundlePart, Frame &part)
+{
+	static const char *const partKeys[BUNDLE_PART_NUM] = { "rgb", "depth", "camera_info" };
+
+	bsoncxx::document::element partElement = bundleFrame.bsonView["msg"][partKeys[bundlePart]];
+
+	if(!partElement){ return false; }
+
+	// {topic, msg} like a frame
+	part.bsonView = partElement.get_document().value;
+
+	bsoncxx::stdx::string_view topicView = part.bsonView["topic"].get_utf8().value;
+
+	part.topic.assign(topicView.data(), topicView.size());
+	part.type = (bundlePart==BUNDLE_CAMERA_INFO) ? TYPE_CAMERA_INFO : TYPE_IMAGE;
+
+	part.isSuperseded = bundleFrame.isSuperseded;
+	part.receivedTime = bundleFrame.receivedTime;
+	part.bundleFrame  = &bundleFrame;
+	part.bundlePart   = bundlePart;
+
+	return true;
+}
+
+ros::Time SIGVerseROSBridge::getFrameStamp(const Frame &frame)
+{
+	// The parts of a bundle are stamped with the bundle stamp
+	const Frame &stampFrame = (frame.bundleFrame != NULL) ? *frame.bundleFrame : frame;
+
+	return getTime(stampFrame.bsonView["msg"]["header"]["stamp"]);
+}
+
+bool SIGVerseROSBridge::isControlType(const std::string &type)
+{
+	return type==TYPE_TWIST || type==TYPE_TF_LIST || type==TYPE_TIME_SYNC || type==TYPE_CLOCK;
+}
+
+SIGVerseROSBridge::Frame *SIGVerseROSBridge::acquireFrame(Connection &connection)
+{
+	Frame *frame;
+
+	if(connection.freeFrames.tryPop(frame)){ return frame; }
+
+	if(connection.allocatedFrameNum < MAX_FRAME_NUM)
+	{
+		connection.allocatedFrameNum++;
+		return new Frame();
+	}
+
+	// Every frame is waiting in the lane or the strands. The one releasing a frame wakes the reactor.
+	connection.isWaitingForFrame = true;
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// Released before the flag was set
+	if(connection.freeFrames.tryPop(frame))
+	{
+		connection.isWaitingForFrame = false;
+		return frame;
+	}
+
+	return NULL;
+}
+
+void SIGVerseROSBridge::releaseFrame(Connection &connection, Frame *frame)
+{
+	// A part belongs to its bundle frame, which is scheduled when its last part is finished.
+	// The strand of the part is still scheduled here, so the connection is not finished in between.
+	if(frame->bundleFrame != NULL)
+	{
+		Frame *bundleFrame = frame->bundleFrame;
+
+		if(--bundleFrame->unfinishedPartNum == 0)
+		{
+			scheduleFrame(connection, *bundleFrame->bundleStrand, bundleFrame);
+		}
+
+		return;
+	}
+
+	frame->bundleStrand = NULL;
+	frame->bundleRgb       .reset();
+	frame->bundleDepth     .reset();
+	frame->bundleCameraInfo.reset();
+
+	// Large frames would otherwise keep up to MAX_FRAME_NUM buffers of their size for the life of the connection
+	if(connection.bufferCapacity > frameBufferLimit){ freeBuffer(connection, *frame); }
+
+	connection.freeFrames.push(frame);
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if(connection.isWaitingForFrame.exchange(false)){ wakeReactor(); }
+}
+
+void SIGVerseROSBridge::freeBuffer(Connection &connection, Frame &frame)
+{
+	size_t capacity = frame.buffer.capacity();
+
+	// Also unlocks the pages of a locked buffer
+	std::vector<uint8_t>().swap(frame.buffer);
+
+	connection.bufferCapacity -= capacity;
+}
+
+// Only the reactor takes free frames, so the frames taken here are not missed by acquireFrame
+void SIGVerseROSBridge::releaseIdleBuffers()
+{
+	ros::WallTime now = ros::WallTime::now();
+
+	for(auto itr = connections.begin(); itr != connections.end(); ++itr)
+	{
+		Connection &connection = *itr->second;
+
+		if(connection.bufferCapacity == 0 || connection.receivingFrame != NULL){ continue; }
+
+		if(now - connection.lastReceivedTime < ros::WallDuration(FRAME_BUFFER_IDLE_TIME)){ continue; }
+
+		std::vector<Frame *> frames;
+
+		Frame *frame;
+
+		while(connection.freeFrames.tryPop(frame))
+		{
+			freeBuffer(connection, *frame);
+			frames.push_back(frame);
+		}
+
+		for(size_t i=0; i<frames.size(); i++){ connection.freeFrames.push(frames[i]); }
+	}
+}
+
+void SIGVerseROSBridge::sendReply(Connection &connection, const std::string &reply)
+{
+	{
+		boost::mutex::scoped_lock lock(connection.outputMutex);
+
+		connection.replies.push_back(Reply());
+		connection.replies.back().text = reply;
+	}
+
+	wakeReactor();
+}
+
+void SIGVerseROSBridge::sendTimeSyncReply(Connection &connection, const ros::Time &t1, const ros::Time &t2)
+{
+	{
+		boost::mutex::scoped_lock lock(connection.outputMutex);
+
+		connection.replies.push_back(Reply());
+		connection.replies.back().isTimeSync = true;
+		connection.replies.back().t1         = t1;
+		connection.replies.back().t2         = t2;
+	}
+
+	wakeReactor();
+}
+
+// Called with the output mutex locked
+void SIGVerseROSBridge::formatReplies(Connection &connection)
+{
+	ros::Time t3 = ros::Time::now();
+
+	for(size_t i=0; i<connection.replies.size(); i++)
+	{
+		const Reply &reply = connection.replies[i];
+
+		if(!reply.isTimeSync)
+		{
+			connection.outputBuffer += reply.text;
+			continue;
+		}
+
+		connection.outputBuffer += "time_sync," +
+			std::to_string(reply.t1.sec) + "," + std::to_string(reply.t1.nsec) + "," +
+			std::to_string(reply.t2.sec) + "," + std::to_string(reply.t2.nsec) + "," +
+			std::to_string(t3      .sec) + "," + std::to_string(t3      .nsec) + "\n";
+	}
+
+	connection.replies.clear();
+}
+
+void SIGVerseROSBridge::flushOutput(Connection &connection)
+{
+	boost::mutex::scoped_lock lock(connection.outputMutex);
+
+	bool canSend = true;
+
+	while(canSend)
+	{
+		// Replies are formatted only when everything before them has been written,
+		// so that the t3 of a time sync reply is taken right before it is passed to the socket
+		if(connection.outputBuffer.empty())
+		{
+			if(connection.replies.empty()){ break; }
+
+			formatReplies(connection);
+		}
+
+		size_t sentSize = 0;
+
+		while(sentSize < connection.outputBuffer.size())
+		{
+			ssize_t size = send(connection.dstSocket, connection.outputBuffer.data() + sentSize, connection.outputBuffer.size() - sentSize, MSG_NOSIGNAL);
+
+			if(size > 0){ sentSize += size; continue; }
+
+			if(size == -1 && errno == EINTR){ continue; }
+
+			if(size == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)){ canSend = false; break; }
+
+			// The peer is gone. Closing is left to the reading side.
+			std::cout << "Can not send. fd=" << connection.dstSocket << " error=" << strerror(errno) << std::endl;
+			sentSize = connection.outputBuffer.size();
+			connection.replies.clear();
+		}
+
+		connection.outputBuffer.erase(0, sentSize);
+	}
+
+	bool isWriting = !connection.outputBuffer.empty() || !connection.replies.empty();
+
+	if(isWriting != connection.isWriting)
+	{
+		connection.isWriting = isWriting;
+		updateEvents(connection);
+	}
+}
+
+void SIGVerseROSBridge::updateEvents(Connection &connection)
+{
+	struct epoll_event event;
+	event.events  = (connection.isReadPaused ? 0 : EPOLLIN) | (connection.isWriting ? EPOLLOUT : 0);
+	event.data.fd = connection.dstSocket;
+
+	epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.dstSocket, &event);
+}
+
+void SIGVerseROSBridge::wakeReactor()
+{
+	uint64_t count = 1;
+
+	ssize_t size = write(wakeFd, &count, sizeof(count));
+	(void)size;
+}
+
+void SIGVerseROSBridge::closeConnection(boost::shared_ptr<Connection> connection)
+{
+	epoll_ctl(epollFd, EPOLL_CTL_DEL, connection->dstSocket, NULL);
+
+	// Only the reactor uses the socket
+	close(connection->dstSocket);
+
+	connections.erase(connection->dstSocket);
+
+	if(connection->receivingFrame != NULL)
+	{
+		connection->freeFrames.push(connection->receivingFrame);
+		connection->receivingFrame = NULL;
+	}
+
+	// Let the lane and the strands finish the frames they have
+	if(connection->controlLane)
+	{
+		connection->controlLane->frameRing.close();
+	}
+
+	closedConnections.push_back(connection);
+}
+
+void SIGVerseROSBridge::finishClosedConnections(bool waitForAll)
+{
+	do
+	{
+		for(size_t i=0; i<closedConnections.size(); )
+		{
+			Connection &connection = *closedConnections[i];
+
+			if((connection.controlLane && !connection.controlLane->isFinished) || connection.scheduledStrandNum > 0)
+			{
+				i++;
+				continue;
+			}
+
+			if(connection.controlLane)
+			{
+				connection.controlLane->thread->join();
+			}
+
+			for(auto itr = connection.topicStrands.begin(); itr != connection.topicStrands.end(); ++itr)
+			{
+				reportDrops(itr->second->topicInfoMap);
+			}
+
+			Frame *frame;
+
+			while(connection.freeFrames.tryPop(frame))
+			{
+				delete frame;
+			}
+
+			closedConnections.erase(closedConnections.begin() + i);
+		}
+
+		if(waitForAll && !closedConnections.empty())
+		{
+			usleep(SHUTDOWN_POLL_INTERVAL);
+		}
+	}
+	while(waitForAll && !closedConnections.empty());
+}
+
+void SIGVerseROSBridge::initDecodeWorker(int workerIndex)
+{
+	decodeTuning.apply("decode" + std::to_string(workerIndex));
+}
+
+void SIGVerseROSBridge::initEncodeWorker(int workerIndex)
+{
+	encodeTuning.apply("encode" + std::to_string(workerIndex));
+}
+
+void SIGVerseROSBridge::processLane(Connection *connection, Lane *lane)
+{
+	controlTuning.apply(lane->name);
+
+	std::deque<Frame *> frames;
+
+	Frame *waitingFrame;
+
+	PublishItem publishItem;
+
+	ros::WallTime reportTime = ros::WallTime::now();
+
+	while(lane->frameRing.pop(waitingFrame))
+	{
+		frames.push_back(waitingFrame);
+
+		while(lane->frameRing.tryPop(waitingFrame))
+		{
+			frames.push_back(waitingFrame);
+		}
+
+		// A frame is superseded when a newer frame of the same topic is already waiting
+		for(size_t i=0; i<frames.size(); i++)
+		{
+			for(size_t j=i+1; j<frames.size(); j++)
+			{
+				if(frames[i]->topic==frames[j]->topic)
+				{
+					frames[i]->isSuperseded = true;
+					break;
+				}
+			}
+		}
+
+		for(size_t i=0; i<frames.size(); i++)
+		{
+			Frame *frame = frames[i];
+
+			FrameResult frameResult = processFrame(*connection, lane->topicInfoMap, *frame, publishItem);
+
+			bool isTfList = (frame->type==TYPE_TF_LIST);
+
+			// The decoded messages do not refer to the frame buffer
+			releaseFrame(*connection, frame);
+
+			if(frameResult == FRAME_DROPPED){ continue; }
+
+			if(frameResult == FRAME_DECODED){ publish(publishItem); }
+
+			if(reportLatency)
+			{
+				double latencyMsec = (ros::WallTime::now() - publishItem.receivedTime).toSec() * 1000.0;
+
+				lane->frameLatency.add(latencyMsec);
+
+				if(isTfList){ lane->tfLatency.add(latencyMsec); }
+			}
+
+			publishItem = PublishItem();
+		}
+
+		frames.clear();
+
+		if(ros::WallTime::now() - reportTime > ros::WallDuration(STATS_REPORT_INTERVAL))
+		{
+			reportDrops(lane->topicInfoMap);
+
+			if(reportLatency)
+			{
+				lane->frameLatency.report(lane->name + " all");
+				lane->tfLatency   .report(lane->name + " " + TYPE_TF_LIST);
+			}
+
+			reportTime = ros::WallTime::now();
+		}
+	}
+
+	reportDrops(lane->topicInfoMap);
+
+	lane->isFinished = true;
+}
+
+void SIGVerseROSBridge::dispatchToStrand(Connection &connection, Frame *frame)
+{
+	scheduleFrame(connection, getStrand(connection, frame->topic), frame);
+}
+
+// Only the reactor creates strands
+SIGVerseROSBridge::TopicStrand &SIGVerseROSBridge::getStrand(Connection &connection, const std::string &topic)
+{
+	boost::shared_ptr<TopicStrand> &strand = connection.topicStrands[topic];
+
+	if(!strand){ strand.reset(new TopicStrand(this, &connection)); }
+
+	return *strand;
+}
+
+void SIGVerseROSBridge::scheduleFrame(Connection &connection, TopicStrand &strand, Frame *frame)
+{
+	boost::mutex::scoped_lock lock(strand.mutex);
+
+	strand.frames.push_back(frame);
+
+	// A strand is in the decode pool at most once, which keeps the frames of a topic in order
+	if(!strand.isScheduled)
+	{
+		strand.isScheduled = true;
+		connection.scheduledStrandNum++;
+
+		decodePool->submit(&strand);
+	}
+}
+
+void SIGVerseROSBridge::processStrand(TopicStrand *strand)
+{
+	std::deque<Frame *> frames;
+
+	{
+		boost::mutex::scoped_lock lock(strand->mutex);
+		frames.swap(strand->frames);
+	}
+
+	PublishItem publishItem;
+
+	for(size_t i=0; i<frames.size(); i++)
+	{
+		Frame *frame = frames[i];
+
+		// Every frame of a strand has the same topic, so only the last one is not superseded
+		frame->isSuperseded = (i+1 < frames.size());
+
+		FrameResult frameResult = processFrame(*strand->connection, strand->topicInfoMap, *frame, publishItem);
+
+		releaseFrame(*strand->connection, frame);
+
+		if(frameResult == FRAME_DROPPED){ continue; }
+
+		if(frameResult == FRAME_DECODED){ publish(publishItem); }
+
+		if(reportLatency){ strand->latency.add((ros::WallTime::now() - publishItem.receivedTime).toSec() * 1000.0); }
+
+		// Release the messages so that they can go back to their pools
+		publishItem = PublishItem();
+	}
+
+	if(ros::WallTime::now() - strand->reportTime > ros::WallDuration(STATS_REPORT_INTERVAL) && !strand->topicInfoMap.empty())
+	{
+		reportDrops(strand->topicInfoMap);
+
+		if(reportLatency){ strand->latency.report(strand->topicInfoMap.begin()->first); }
+
+		strand->reportTime = ros::WallTime::now();
+	}
+
+	Connection *connection = strand->connection;
+
+	{
+		boost::mutex::scoped_lock lock(strand->mutex);
+
+		// Frames arrived meanwhile. Go to the back of the queue so that other topics are not starved.
+		if(!strand->frames.empty())
+		{
+			decodePool->submit(strand);
+			return;
+		}
+
+		strand->isScheduled = false;
+	}
+
+	// The connection may be gone after this
+	connection->scheduledStrandNum--;
+}
+
+void SIGVerseROSBridge::publish(const PublishItem &publishItem)
+{
+	if     (publishItem.twist)     { publishItem.publisher->publish(publishItem.twist); }
+	else if(publishItem.cameraInfo){ publishItem.publisher->publish(publishItem.cameraInfo); }
+	else if(publishItem.image)     { publishItem.publisher->publish(publishItem.image); }
+	else if(publishItem.laserScan) { publishItem.publisher->publish(publishItem.laserScan); }
+	else if(publishItem.tfMessage) { publishItem.publisher->publish(publishItem.tfMessage); }
+}
+
+SIGVerseROSBridge::TopicInfo *SIGVerseROSBridge::getTopicInfo(std::map<std::string, TopicInfo> &topicInfoMap, const std::string &topicValue, const std::string &typeValue)
+{
+	std::map<std::string, TopicInfo>::iterator topicInfoItr = topicInfoMap.find(topicValue);
+
+	if(topicInfoItr!=topicInfoMap.end()){ return &topicInfoItr->second; }
+
+	// Advertise
+	// TF lists are always published on /tf
+	const std::string &advertisedTopic = (typeValue==TYPE_TF_LIST) ? std::string(TF_TOPIC) : topicValue;
+
+	TopicPolicy topicPolicy = topicPolicyTable.get(nodeHandle.resolveName(advertisedTopic));
+
+	ros::Publisher publisher;
+
+	if(typeValue==TYPE_TWIST)
+	{
+		publisher = nodeHandle.advertise<geometry_msgs::Twist>(topicValue, topicPolicy.getQueueSize(DEFAULT_TWIST_QUEUE_SIZE), topicPolicy.latch);
+	}
+	else if(typeValue==TYPE_CAMERA_INFO)
+	{
+		publisher = nodeHandle.advertise<sensor_msgs::CameraInfo>(topicValue, topicPolicy.getQueueSize(DEFAULT_SENSOR_QUEUE_SIZE), topicPolicy.latch);
+	}
+	else if(typeValue==TYPE_IMAGE)
+	{
+		publisher = nodeHandle.advertise<sensor_msgs::Image>(topicValue, topicPolicy.getQueueSize(DEFAULT_SENSOR_QUEUE_SIZE), topicPolicy.latch);
+	}
+	else if(typeValue==TYPE_LASER_SCAN)
+	{
+		publisher = nodeHandle.advertise<sensor_msgs::LaserScan>(topicValue, topicPolicy.getQueueSize(DEFAULT_SENSOR_QUEUE_SIZE), topicPolicy.latch);
+	}
+	else if(typeValue==TYPE_TF_LIST)
+	{
+		publisher = nodeHandle.advertise<tf2_msgs::TFMessage>(advertisedTopic, topicPolicy.getQueueSize(DEFAULT_TF_QUEUE_SIZE), topicPolicy.latch);
+	}
+	else if(typeValue==TYPE_SENSOR_BUNDLE)
+	{
+		// The parts are published on their own topics. The bundle message itself is optional.
+		if(publishBundles)
+		{
+			publisher = nodeHandle.advertise<sigverse_ros_bridge::SensorBundle>(topicValue, topicPolicy.getQueueSize(DEFAULT_SENSOR_QUEUE_SIZE), topicPolicy.latch);
+		}
+	}
+	else
+	{
+		std::cout << "Not compatible message type! :" << typeValue << std::endl;
+		return NULL;
+	}
+
+	if(publisher){ std::cout << "Advertised " << advertisedTopic << std::endl; }
+
+	topicInfoItr = topicInfoMap.insert(std::make_pair(topicValue, TopicInfo(publisher, topicPolicy))).first;
+
+	if(typeValue==TYPE_TF_LIST){ topicInfoItr->second.frameIdTable.setPrefix(tfPrefix); }
+
+	std::string resolvedTopic = nodeHandle.resolveName(advertisedTopic);
+
+	if(typeValue==TYPE_CAMERA_INFO && sensorOutputTable.isCameraInfoUsed(resolvedTopic))
+	{
+		topicInfoItr->second.cameraModelTopic = resolvedTopic;
+	}
+
+	const DepthCloudOutput *cloudOutput = (typeValue==TYPE_IMAGE) ? sensorOutputTable.getCloud(resolvedTopic) : NULL;
+
+	if(cloudOutput!=NULL)
+	{
+		TopicPolicy cloudPolicy = topicPolicyTable.get(cloudOutput->pointsTopic);
+
+		topicInfoItr->second.cloudPublisher = nodeHandle.advertise<sensor_msgs::PointCloud2>(cloudOutput->pointsTopic, cloudPolicy.getQueueSize(DEFAULT_SENSOR_QUEUE_SIZE), cloudPolicy.latch);
+		topicInfoItr->second.cloudCameraInfoTopic = cloudOutput->cameraInfoTopic;
+
+		std::cout << "Advertised " << cloudOutput->pointsTopic << std::endl;
+	}
+
+	std::string scanCloudTopic = (typeValue==TYPE_LASER_SCAN) ? sensorOutputTable.getScanCloudTopic(resolvedTopic) : std::string();
+
+	if(!scanCloudTopic.empty())
+	{
+		TopicPolicy cloudPolicy = topicPolicyTable.get(scanCloudTopic);
+
+		topicInfoItr->second.cloudPublisher = nodeHandle.advertise<sensor_msgs::PointCloud2>(scanCloudTopic, cloudPolicy.getQueueSize(DEFAULT_SENSOR_QUEUE_SIZE), cloudPolicy.latch);
+
+		std::cout << "Advertised " << scanCloudTopic << std::endl;
+	}
+
+	int pyramidLevelNum = (typeValue==TYPE_IMAGE) ? std::min(topicPolicy.pyramidLevelNum, PYRAMID_MAX_LEVEL_NUM) : 0;
+
+	for(int level=0; level<pyramidLevelNum; level++)
+	{
+		static const char *levelNames[PYRAMID_MAX_LEVEL_NUM] = { "half", "quarter" };
+
+		std::string pyramidTopic  = resolvedTopic + "/" + levelNames[level];
+		TopicPolicy pyramidPolicy = topicPolicyTable.get(pyramidTopic);
+
+		topicInfoItr->second.pyramidPublishers[level] = nodeHandle.advertise<sensor_msgs::Image>(pyramidTopic, pyramidPolicy.getQueueSize(DEFAULT_SENSOR_QUEUE_SIZE), pyramidPolicy.latch);
+
+		std::cout << "Advertised " << pyramidTopic << std::endl;
+	}
+
+	if(typeValue==TYPE_IMAGE && topicPolicy.useImageTransport)
+	{
+		boost::shared_ptr<CompressedOutput> compressedOutput(new CompressedOutput());
+
+		{
+			boost::mutex::scoped_lock lock(imageTransportMutex);
+
+			// The raw images keep the topic publisher, so that they are never delayed by an encoder
+			nodeHandle.setParam(resolvedTopic + "/disable_pub_plugins", std::vector<std::string>(1, "image_transport/raw"));
+
+			compressedOutput->publisher = imageTransport.advertise(resolvedTopic, topicPolicy.getQueueSize(DEFAULT_SENSOR_QUEUE_SIZE), topicPolicy.latch);
+		}
+
+		topicInfoItr->second.compressedOutput = compressedOutput;
+
+		std::cout << "Advertised the image_transport plugins of " << resolvedTopic << std::endl;
+	}
+
+	const DepthScanOutput *scanOutput = (typeValue==TYPE_IMAGE) ? sensorOutputTable.getScan(resolvedTopic) : NULL;
+
+	if(scanOutput!=NULL)
+	{
+		TopicPolicy scanPolicy = topicPolicyTable.get(scanOutput->scanTopic);
+
+		topicInfoItr->second.scanPublisher = nodeHandle.advertise<sensor_msgs::LaserScan>(scanOutput->scanTopic, scanPolicy.getQueueSize(DEFAULT_SENSOR_QUEUE_SIZE), scanPolicy.latch);
+		topicInfoItr->second.scanOutput    = scanOutput;
+
+		std::cout << "Advertised " << scanOutput->scanTopic << std::endl;
+	}
+
+	return &topicInfoItr->second;
+}
+
+SIGVerseROSBridge::FrameResult SIGVerseROSBridge::processFrame(Connection &connection, std::map<std::string, TopicInfo> &topicInfoMap, Frame &frame, PublishItem &publishItem)
+{
+	const bsoncxx::document::view &bsonView = frame.bsonView;
+
+	const std::string &topicValue = frame.topic;
+	const std::string &typeValue  = frame.type;
+
+//	std::cout << "tp:" << topicValue << std::endl;
+
+	TopicInfo *topicInfo = NULL;
+
+	// Converts the simulator stamps into ROS time. Invalid (no conversion) unless enabled.
+	ClockConversion clockConversion;
+
+	if(correctStamps && typeValue!=TYPE_TWIST && typeValue!=TYPE_TIME_SYNC && typeValue!=TYPE_CLOCK)
+	{
+		clockConversion = connection.clockSync.getConversion();
+	}
+
+	// Without priority lanes the parts of a bundle are processed here, each with the policy of its topic
+	if(typeValue==TYPE_SENSOR_BUNDLE && frame.bundleStrand==NULL)
+	{
+		processBundleParts(connection, topicInfoMap, frame);
+	}
+
+	if(typeValue!=TYPE_TIME_SYNC && typeValue!=TYPE_CLOCK)
+	{
+		topicInfo = getTopicInfo(topicInfoMap, topicValue, typeValue);
+
+		if(topicInfo==NULL){ return FRAME_DROPPED; }
+
+		if(shouldDrop(*topicInfo, frame, clockConversion)){ return FRAME_DROPPED; }
+
+		publishItem.publisher = &topicInfo->publisher;
+	}
+
+	publishItem.receivedTime = frame.receivedTime;
+
+	// Decode
+	// Twist
+	if(typeValue==TYPE_TWIST)
+	{
+		geometry_msgs::TwistPtr twist = boost::make_shared<geometry_msgs::Twist>();
+
+		twist->linear.x = bsonView["msg"]["linear"]["x"].get_double();
+		twist->linear.y = bsonView["msg"]["linear"]["y"].get_double();
+		twist->linear.z = bsonView["msg"]["linear"]["z"].get_double();
+
+		twist->angular.x = bsonView["msg"]["angular"]["x"].get_double();
+		twist->angular.y = bsonView["msg"]["angular"]["y"].get_double();
+		twist->angular.z = bsonView["msg"]["angular"]["z"].get_double();
+
+		publishItem.twist = twist;
+
+		return FRAME_DECODED;
+	}
+	// CameraInfo
+	else if(typeValue==TYPE_CAMERA_INFO)
+	{
+		sensor_msgs::CameraInfoPtr cameraInfo = topicInfo->cameraInfoPool.acquire();
+
+		decodeCameraInfo(*topicInfo, bsonView["msg"].get_document().value, clockConversion, *cameraInfo);
+
+		if(frame.bundleFrame != NULL)
+		{
+			cameraInfo->header.stamp = getFrameStamp(frame);
+			clockConversion.toRosTime(cameraInfo->header.stamp);
+
+			frame.bundleFrame->bundleCameraInfo = cameraInfo;
+		}
+
+		publishItem.cameraInfo = cameraInfo;
+
+		return FRAME_DECODED;
+	}
+	// Image
+	else if(typeValue==TYPE_IMAGE)
+	{
+		sensor_msgs::ImagePtr image = topicInfo->imagePool.acquire();
+
+		decodeImage(*topicInfo, bsonView["msg"].get_document().value, clockConversion, *image);
+
+		if(frame.bundleFrame != NULL)
+		{
+			image->header.stamp = getFrameStamp(frame);
+			clockConversion.toRosTime(image->header.stamp);
+
+			(frame.bundlePart==BUNDLE_RGB ? frame.bundleFrame->bundleRgb : frame.bundleFrame->bundleDepth) = image;
+		}
+
+		publishImageOutputs(*topicInfo, topicValue, image);
+
+		publishItem.image = image;
+
+		return FRAME_DECODED;
+	}
+	// LaserScan
+	else if(typeValue==TYPE_LASER_SCAN)
+	{
+		sensor_msgs::LaserScanPtr laserScan = topicInfo->laserScanPool.acquire();
+
+		laserScan->header.seq        = (uint32_t)bsonView["msg"]["header"]["seq"]           .get_int32();
+		laserScan->header.stamp.sec  = (uint32_t)bsonView["msg"]["header"]["stamp"]["secs"] .get_int32();
+		laserScan->header.stamp.nsec = (uint32_t)bsonView["msg"]["header"]["stamp"]["nsecs"].get_int32();
+		clockConversion.toRosTime(laserScan->header.stamp);
+		setFrameId(laserScan->header.frame_id, bsonView["msg"]["header"]["frame_id"]);
+
+		laserScan->angle_min       = (float)bsonView["msg"]["angle_min"]      .get_double();
+		laserScan->angle_max       = (float)bsonView["msg"]["angle_max"]      .get_double();
+		laserScan->angle_increment = (float)bsonView["msg"]["angle_increment"].get_double();
+		laserScan->time_increment  = (float)bsonView["msg"]["time_increment"] .get_double();
+		laserScan->scan_time       = (float)bsonView["msg"]["scan_time"]      .get_double();
+		laserScan->range_min       = (float)bsonView["msg"]["range_min"]      .get_double();
+		laserScan->range_max       = (float)bsonView["msg"]["range_max"]      .get_double();
+
+		size_t sizet = (size_t)((laserScan->angle_max - laserScan->angle_min) / laserScan->angle_increment + 1);
+
+		laserScan->ranges.resize(sizet);
+		laserScan->intensities.resize(sizet);
+
+		bsoncxx::array::view dView_ranges = bsonView["msg"]["ranges"].get_array().value;
+		laserScan->ranges.resize(std::distance(dView_ranges.cbegin(), dView_ranges.cend()));
+		setVectorFloat(laserScan->ranges, dView_ranges);
+
+		bsoncxx::array::view dView_intensities = bsonView["msg"]["intensities"].get_array().value;
+		laserScan->intensities.resize(std::distance(dView_intensities.cbegin(), dView_intensities.cend()));
+		setVectorFloat(laserScan->intensities, dView_intensities);
+
+		publishScanCloud(*topicInfo, *laserScan);
+
+		publishItem.laserScan = laserScan;
+
+		return FRAME_DECODED;
+	}
+	// RGB, depth and camera info taken at the same time (SIGVerse Original Type)
+	else if(typeValue==TYPE_SENSOR_BUNDLE)
+	{
+		processSensorBundle(*topicInfo, frame, clockConversion);
+
+		return FRAME_PROCESSED;
+	}
+	// Time Synchronization (SIGVerse Original Type)
+	else if(typeValue==TYPE_TIME_SYNC)
+	{
+		ros::Time timestamp = getTime(bsonView["msg"]["data"]);
+
+		// When the request arrived, in ROS time
+		ros::Time receivedTime = ros::Time::now() - ros::Duration((ros::WallTime::now() - frame.receivedTime).toSec());
+
+		bsoncxx::document::element ntpElement = bsonView["msg"]["ntp"];
+
+		// NTP-style exchange. The client sends the timestamps of the previous exchange with the next request.
+		if(ntpElement && ntpElement.get_bool())
+		{
+			if(bsonView["msg"]["t4"])
+			{
+				connection.clockSync.addRoundTripSample
+				(
+					getTime(bsonView["msg"]["t1"]), getTime(bsonView["msg"]["t2"]),
+					getTime(bsonView["msg"]["t3"]), getTime(bsonView["msg"]["t4"])
+				);
+			}
+
+			// t3 is taken when the reactor writes the reply, so that the time in the output queue is not taken for network delay
+			sendTimeSyncReply(connection, timestamp, receivedTime);
+		}
+		else
+		{
+			connection.clockSync.addOneWaySample(timestamp, receivedTime);
+
+			// Legacy clients are answered a limited number of times in total
+			int syncTimeNum = syncTimeCnt.load();
+
+			while(syncTimeNum < syncTimeMaxNum && !syncTimeCnt.compare_exchange_weak(syncTimeNum, syncTimeNum + 1)){}
+
+			if(syncTimeNum < syncTimeMaxNum)
+			{
+				ros::Time now = ros::Time::now();
+
+				int gapSec  = ((int)timestamp.sec  - (int)now.sec);
+				int gapMsec = ((int)timestamp.nsec - (int)now.nsec) /1000 /1000;
+
+				std::string timeGap = "time_gap," + std::to_string(gapSec) + "," + std::to_string(gapMsec);
+
+				sendReply(connection, timeGap);
+
+				std::cout << "TYPE_TIME_SYNC " << timeGap.c_str() << std::endl;
+			}
+		}
+
+		publishClockQuality(connection);
+	}
+	// Simulator clock (SIGVerse Original Type)
+	else if(typeValue==TYPE_CLOCK)
+	{
+		publishClock(getTime(bsonView["msg"]["clock"]));
+	}
+	// Tf list data (SIGVerse Original Type)
+	else if(typeValue==TYPE_TF_LIST)
+	{
+		tf2_msgs::TFMessagePtr tfMessage = topicInfo->tfMessagePool.acquire();
+
+		bsoncxx::array::view tfArrayView = bsonView["msg"].get_array().value;
+
+		// A recycled message keeps the transforms and their frame id strings of the previous list
+		tfMessage->transforms.resize((size_t)std::distance(tfArrayView.cbegin(), tfArrayView.cend()));
+
+		size_t transformNum = 0;
+
+		ros::Time now; // Taken once for the entries without a stamp
+
+		std::vector<geometry_msgs::TransformStamped> promotedTransforms;
+		std::vector<std::string>                     demotedFrameIds;
+
+		for(auto itr = tfArrayView.cbegin(); itr != tfArrayView.cend(); ++itr)
+		{
+			geometry_msgs::TransformStamped &transformStamped = tfMessage->transforms[transformNum];
+
+			bsoncxx::stdx::string_view frameIdView      = (*itr)["header"]["frame_id"].get_utf8().value;
+			bsoncxx::stdx::string_view childFrameIdView = (*itr)["child_frame_id"]    .get_utf8().value;
+
+			transformStamped.header.frame_id = topicInfo->frameIdTable.get(frameIdView.data(),      frameIdView.size());
+			transformStamped.child_frame_id  = topicInfo->frameIdTable.get(childFrameIdView.data(), childFrameIdView.size());
+
+			transformStamped.header.stamp.sec  = (uint32_t)(*itr)["header"]["stamp"]["secs"] .get_int32();
+			transformStamped.header.stamp.nsec = (uint32_t)(*itr)["header"]["stamp"]["nsecs"].get_int32();
+
+			if(transformStamped.header.stamp.sec == 0)
+			{
+				if(now.isZero()){ now = ros::Time::now(); }
+
+				transformStamped.header.stamp = now;
+			}
+			else
+			{
+				clockConversion.toRosTime(transformStamped.header.stamp);
+			}
+
+			bsoncxx::document::view translationView = (*itr)["transform"]["translation"].get_document().value;
+			bsoncxx::document::view rotationView    = (*itr)["transform"]["rotation"]   .get_document().value;
+
+			transformStamped.transform.translation.x = translationView["x"].get_double();
+			transformStamped.transform.translation.y = translationView["y"].get_double();
+			transformStamped.transform.translation.z = translationView["z"].get_double();
+
+			transformStamped.transform.rotation.x = rotationView["x"].get_double();
+			transformStamped.transform.rotation.y = rotationView["y"].get_double();
+			transformStamped.transform.rotation.z = rotationView["z"].get_double();
+			transformStamped.transform.rotation.w = rotationView["w"].get_double();
+
+			if(tfStaticFrameNum > 0 || !tfDeadbandTable.empty())
+			{
+				TfFrameState &frameState = topicInfo->tfFrameStates[transformStamped.child_frame_id];
+
+				// Overwritten by the next transform
+				if(isStaticTransform(frameState, transformStamped, promotedTransforms, demotedFrameIds)){ continue; }
+
+				if(isWithinDeadband(frameState, transformStamped))
+				{
+					topicInfo->deadbandDropNum++;
+					continue;
+				}
+			}
+
+			transformNum++;
+		}
+
+		tfMessage->transforms.resize(transformNum);
+
+		if(!promotedTransforms.empty() || !demotedFrameIds.empty())
+		{
+			publishStaticTransforms(promotedTransforms, demotedFrameIds);
+		}
+
+		if(transformNum == 0){ return FRAME_PROCESSED; }
+
+		publishItem.tfMessage = tfMessage;
+
+		return FRAME_DECODED;
+	}
 
-pid_t SIGVerseROSBridge::gettid(void)
-{
-	return syscall(SYS_gettid);
+//	std::cout << "published. topic=" << topicValue << std::endl;
+
+	return FRAME_PROCESSED;
 }
 
-void SIGVerseROSBridge::rosSigintHandler(int sig)
+bool SIGVerseROSBridge::isStaticTransform(TfFrameState &frameState, const geometry_msgs::TransformStamped &transformStamped,
+                                          std::vector<geometry_msgs::TransformStamped> &promotedTransforms, std::vector<std::string> &demotedFrameIds)
 {
-	isRunning = false;
+	if(tfStaticFrameNum <= 0){ return false; }
 
-	ros::shutdown();
-}
+	const geometry_msgs::Transform &transform = transformStamped.transform;
+	const geometry_msgs::Transform &last      = frameState.transform;
 
-bool SIGVerseROSBridge::checkReceivable( int fd )
-{
-	fd_set fdset;
-	int ret;
-	struct timeval timeout;
-	FD_ZERO( &fdset );
-	FD_SET( fd , &fdset );
+	bool isUnchanged =
+		frameState.parentFrameId == transformStamped.header.frame_id &&
+		transform.translation.x == last.translation.x && transform.translation.y == last.translation.y && transform.translation.z == last.translation.z &&
+		transform.rotation.x    == last.rotation.x    && transform.rotation.y    == last.rotation.y    &&
+		transform.rotation.z    == last.rotation.z    && transform.rotation.w    == last.rotation.w;
+
+	if(isUnchanged)
+	{
+		if(frameState.isStatic){ return true; }
 
-	// timeout is 1 sec
-	timeout.tv_sec = 1;
-	timeout.tv_usec = 0;
+		if(++frameState.unchangedNum < tfStaticFrameNum){ return false; }
 
-	ret = select( fd+1 , &fdset , NULL , NULL , &timeout );
+		frameState.isStatic = true;
+		promotedTransforms.push_back(transformStamped);
 
-	return ret == 1;
-}
+		return true;
+	}
+
+	// Moved again. Listeners that hold it as static are updated by /tf.
+	if(frameState.isStatic)
+	{
+		frameState.isStatic = false;
+		demotedFrameIds.push_back(transformStamped.child_frame_id);
+
+		// The transform last published on /tf is from before the promotion. The first dynamic sample must not be
+		// held back by the deadband against it.
+		frameState.hasPublished       = false;
+		frameState.publishedTransform = geometry_msgs::Transform();
+		frameState.publishedStamp     = ros::Time();
+	}
 
+	frameState.parentFrameId = transformStamped.header.frame_id;
+	frameState.transform     = transform;
+	frameState.unchangedNum  = 1;
 
-void SIGVerseROSBridge::setVectorDouble(std::vector<double> &destVec, const bsoncxx::array::view &arrayView)
+	return false;
+}
+
+void SIGVerseROSBridge::processBundleParts(Connection &connection, std::map<std::string, TopicInfo> &topicInfoMap, Frame &frame)
 {
-	int i = 0;
+	PublishItem publishItem;
 
-	for(auto itr = arrayView.cbegin(); itr != arrayView.cend(); ++itr)
+	for(int i=0; i<BUNDLE_PART_NUM; i++)
 	{
-		destVec[i++] = (*itr).get_double();
+		boost::shared_ptr<Frame> &part = frame.bundleParts[i];
+
+		if(!part){ part.reset(new Frame()); }
+
+		if(!getBundlePart(frame, (BundlePart)i, *part)){ continue; }
+
+		if(processFrame(connection, topicInfoMap, *part, publishItem) == FRAME_DECODED){ publish(publishItem); }
+
+		publishItem = PublishItem();
 	}
 }
 
-void SIGVerseROSBridge::setVectorFloat(std::vector<float> &destVec, const bsoncxx::array::view &arrayView)
+// The parts have been published as messages of their own topics and left in the bundle frame
+void SIGVerseROSBridge::processSensorBundle(TopicInfo &bundleInfo, const Frame &frame, const ClockConversion &clockConversion)
 {
-	int i = 0;
+	// The bundle message copies the images, so it is built only for its subscribers
+	if(!bundleInfo.publisher || bundleInfo.publisher.getNumSubscribers() == 0){ return; }
 
-	for(auto itr = arrayView.cbegin(); itr != arrayView.cend(); ++itr)
+	bsoncxx::document::view msgView = frame.bsonView["msg"].get_document().value;
+
+	sigverse_ros_bridge::SensorBundlePtr bundle = boost::make_shared<sigverse_ros_bridge::SensorBundle>();
+
+	bundle->header.seq   = (uint32_t)msgView["header"]["seq"].get_int32();
+	bundle->header.stamp = getFrameStamp(frame);
+	clockConversion.toRosTime(bundle->header.stamp);
+	setFrameId(bundle->header.frame_id, msgView["header"]["frame_id"]);
+
+	if(frame.bundleRgb)       { bundle->rgb         = *frame.bundleRgb; }
+	if(frame.bundleDepth)     { bundle->depth       = *frame.bundleDepth; }
+	if(frame.bundleCameraInfo){ bundle->camera_info = *frame.bundleCameraInfo; }
+
+	bundleInfo.publisher.publish(bundle);
+}
+
+void SIGVerseROSBridge::decodeImage(TopicInfo &topicInfo, const bsoncxx::document::view &msgView, const ClockConversion &clockConversion, sensor_msgs::Image &image)
+{
+	image.header.seq        = (uint32_t)msgView["header"]["seq"]           .get_int32();
+	image.header.stamp.sec  = (uint32_t)msgView["header"]["stamp"]["secs"] .get_int32();
+	image.header.stamp.nsec = (uint32_t)msgView["header"]["stamp"]["nsecs"].get_int32();
+	clockConversion.toRosTime(image.header.stamp);
+	setFrameId(image.header.frame_id, msgView["header"]["frame_id"]);
+	image.height            = (uint32_t)msgView["height"]      .get_int32();
+	image.width             = (uint32_t)msgView["width"]       .get_int32();
+	image.encoding          =           msgView["encoding"]    .get_utf8().value.to_string();
+	image.is_bigendian      = (uint8_t) msgView["is_bigendian"].get_int32(); //.raw()[0];
+	image.step              = (uint32_t)msgView["step"]        .get_int32();
+
+	bsoncxx::types::b_binary binary = msgView["data"].get_binary();
+
+	const ImageTransform &imageTransform = topicInfo.policy.imageTransform;
+
+	if(imageTransform.isIdentity())
 	{
-		destVec[i++] = (float)((*itr).get_double());
+		size_t sizet = (image.step * image.height);
+		image.data.resize(sizet);
+		memcpy(&image.data[0], binary.bytes, sizet);
+		return;
+	}
+
+	// The flip and the conversion are done while copying
+	std::string receivedEncoding = image.encoding;
+
+	if(!copyImageData(binary.bytes, binary.size, imageTransform, image) && !topicInfo.isImageTransformReported)
+	{
+		std::cout << "Cannot convert " << receivedEncoding << " into " << imageTransform.encoding << " on " << topicInfo.publisher.getTopic() << std::endl;
+		topicInfo.isImageTransformReported = true;
 	}
 }
 
-template < size_t ArrayNum >
-void SIGVerseROSBridge::setArrayDouble(boost::array<double, ArrayNum> &destArray, const bsoncxx::array::view &arrayView)
+void SIGVerseROSBridge::decodeCameraInfo(TopicInfo &topicInfo, const bsoncxx::document::view &msgView, const ClockConversion &clockConversion, sensor_msgs::CameraInfo &cameraInfo)
 {
-	int i = 0;
+	// The intrinsics rarely change. They are decoded only when the raw BSON differs from the last decoded one.
+	uint64_t bodyHash = hashElements(msgView, "header");
 
-	for(auto itr = arrayView.cbegin(); itr != arrayView.cend(); ++itr)
+	if(topicInfo.hasCameraInfoBody && bodyHash == topicInfo.cameraInfoBodyHash)
 	{
-		destArray[i++] = (*itr).get_double();
+		// Keeps the capacity of the recycled message. The header is overwritten below.
+		cameraInfo = topicInfo.cameraInfoBody;
+	}
+	else
+	{
+		cameraInfo.height            = (uint32_t)msgView["height"].get_int32();
+		cameraInfo.width             = (uint32_t)msgView["width"] .get_int32();
+		cameraInfo.distortion_model  =           msgView["distortion_model"].get_utf8().value.to_string();
+
+		bsoncxx::array::view dView = msgView["D"].get_array().value;
+		cameraInfo.D.resize((size_t)std::distance(dView.cbegin(), dView.cend()));
+		setVectorDouble(cameraInfo.D, dView);
+
+		setArrayDouble(cameraInfo.K, msgView["K"].get_array().value);
+		setArrayDouble(cameraInfo.R, msgView["R"].get_array().value);
+		setArrayDouble(cameraInfo.P, msgView["P"].get_array().value);
+
+		cameraInfo.binning_x         = (uint32_t)msgView["binning_x"].get_int32();
+		cameraInfo.binning_y         = (uint32_t)msgView["binning_y"].get_int32();
+		cameraInfo.roi.x_offset      = (uint32_t)msgView["roi"]["x_offset"]  .get_int32();
+		cameraInfo.roi.y_offset      = (uint32_t)msgView["roi"]["y_offset"]  .get_int32();
+		cameraInfo.roi.height        = (uint32_t)msgView["roi"]["height"]    .get_int32();
+		cameraInfo.roi.width         = (uint32_t)msgView["roi"]["width"]     .get_int32();
+		cameraInfo.roi.do_rectify    = (uint8_t) msgView["roi"]["do_rectify"].get_bool();
+
+		topicInfo.cameraInfoBody     = cameraInfo;
+		topicInfo.cameraInfoBodyHash = bodyHash;
+		topicInfo.hasCameraInfoBody  = true;
+
+		if(!topicInfo.cameraModelTopic.empty())
+		{
+			boost::mutex::scoped_lock lock(cameraModelMutex);
+			cameraModels[topicInfo.cameraModelTopic] = CameraModel(cameraInfo);
+		}
 	}
+
+	cameraInfo.header.seq        = (uint32_t)msgView["header"]["seq"]           .get_int32();
+	cameraInfo.header.stamp.sec  = (uint32_t)msgView["header"]["stamp"]["secs"] .get_int32();
+	cameraInfo.header.stamp.nsec = (uint32_t)msgView["header"]["stamp"]["nsecs"].get_int32();
+	clockConversion.toRosTime(cameraInfo.header.stamp);
+	setFrameId(cameraInfo.header.frame_id, msgView["header"]["frame_id"]);
 }
 
+bool SIGVerseROSBridge::getCameraModel(const std::string &cameraInfoTopic, CameraModel &cameraModel)
+{
+	boost::mutex::scoped_lock lock(cameraModelMutex);
+
+	std::map<std::string, CameraModel>::const_iterator cameraModelItr = cameraModels.find(cameraInfoTopic);
 
+	// No camera info has arrived yet
+	if(cameraModelItr==cameraModels.end()){ return false; }
 
+	cameraModel = cameraModelItr->second;
 
-void * SIGVerseROSBridge::receivingThread(void *param)
+	return true;
+}
+
+void SIGVerseROSBridge::publishImageOutputs(TopicInfo &topicInfo, const std::string &topicValue, const sensor_msgs::ImagePtr &image)
 {
-	int dstSocket = *((int *)param);
+	publishDepthCloud(topicInfo, topicValue, *image);
+	publishDepthScan (topicInfo, topicValue, *image);
+	publishPyramid   (topicInfo, topicValue, *image);
+	publishCompressed(topicInfo, image);
+}
 
-	int dummyArgc = 0;
-	char **dummyArgv;
+void SIGVerseROSBridge::publishCompressed(TopicInfo &topicInfo, const sensor_msgs::ImagePtr &image)
+{
+	const boost::shared_ptr<CompressedOutput> &compressedOutput = topicInfo.compressedOutput;
 
-	char *buf;
-	buf = new char [BUFFER_SIZE];
+	// Encoded only while somebody listens to one of the plugins
+	if(!compressedOutput || !encodePool || compressedOutput->publisher.getNumSubscribers()==0){ return; }
 
-	if(buf == NULL)
+	// One frame of a topic at a time, so that stateful encoders (e.g. theora) get the frames in order
+	if(compressedOutput->isEncoding.exchange(true))
 	{
-		std::cout << "Cannot malloc!" << std::endl;
-		exit(EXIT_FAILURE);
+		topicInfo.encoderDropNum++;
+		return;
 	}
 
-	long int totalReceivedSize;
-
-	std::map<std::string, ros::Publisher> publisherMap;
+	// The image is not recycled by the pool until the job has released it
+	if(!encodePool->trySubmit(boost::bind(&SIGVerseROSBridge::encodeImage, compressedOutput, sensor_msgs::ImageConstPtr(image))))
+	{
+		compressedOutput->isEncoding = false;
+		topicInfo.encoderDropNum++;
+	}
+}
 
-	std::cout << "Socket open. tid=" << gettid() << std::endl;
+void SIGVerseROSBridge::encodeImage(const boost::shared_ptr<CompressedOutput> &compressedOutput, const sensor_msgs::ImageConstPtr &image)
+{
+	compressedOutput->publisher.publish(image);
 
-	// Initialize ROS
-	ros::init(dummyArgc, dummyArgv, "sigverse_ros_bridge_"+std::to_string(gettid()), ros::init_options::NoSigintHandler);
+	compressedOutput->isEncoding = false;
+}
 
-	ros::NodeHandle rosNodeHandle;
+void SIGVerseROSBridge::publishPyramid(TopicInfo &topicInfo, const std::string &topicValue, const sensor_msgs::Image &image)
+{
+	// Levels down to the smallest one with subscribers. Each level is made from the one above.
+	int levelNum = 0;
 
-	// Override the default ros sigint handler.
-	// This must be set after the first NodeHandle is created.
-	signal(SIGINT, rosSigintHandler);
+	for(int level=0; level<PYRAMID_MAX_LEVEL_NUM; level++)
+	{
+		if(topicInfo.pyramidPublishers[level] && topicInfo.pyramidPublishers[level].getNumSubscribers() > 0){ levelNum = level+1; }
+	}
 
-	ros::Rate loop_rate(100);
+	const sensor_msgs::Image *source = &image;
 
-	while(ros::ok())
+	for(int level=0; level<levelNum; level++)
 	{
-		// Get total BSON data size
-		totalReceivedSize = 0;
+		sensor_msgs::ImagePtr scaledImage = topicInfo.pyramidPools[level].acquire();
 
-		if(!checkReceivable(dstSocket)){ continue; }
+		if(!downscaleImage(*source, *scaledImage))
+		{
+			if(!topicInfo.isPyramidReported)
+			{
+				std::cout << "Cannot downscale " << topicValue << " (" << image.encoding << " " << source->width << "x" << source->height << ")" << std::endl;
+				topicInfo.isPyramidReported = true;
+			}
+			return;
+		}
 
-		char bufHeader[4];
+		if(topicInfo.pyramidPublishers[level].getNumSubscribers() > 0){ topicInfo.pyramidPublishers[level].publish(scaledImage); }
 
-		long int numRcv = read(dstSocket, bufHeader, sizeof(4));
+		source = scaledImage.get();
+	}
+}
 
-		if(numRcv == 0)
-		{
-			close(dstSocket);
-			std::cout << "Socket closed. tid=" << gettid() << std::endl;
-			break;
-		}
-		if(numRcv == -1)
-		{
-			close(dstSocket);
-			std::cout << "Socket error. tid=" << gettid() << std::endl;
-			break;
-		}
-		if(numRcv < 4)
-		{
-			close(dstSocket);
-			std::cout << "Can not get data size... tid=" << gettid() << std::endl;
-			break;
-		}
-		totalReceivedSize += 4;
+void SIGVerseROSBridge::publishDepthCloud(TopicInfo &topicInfo, const std::string &topicValue, const sensor_msgs::Image &depth)
+{
+	// Projected only while somebody listens
+	if(!topicInfo.cloudPublisher || topicInfo.cloudPublisher.getNumSubscribers()==0){ return; }
+
+	CameraModel cameraModel;
+
+	if(!getCameraModel(topicInfo.cloudCameraInfoTopic, cameraModel)){ return; }
 
-		int32_t msgSize;
-		memcpy(&msgSize, &bufHeader, sizeof(int32_t));
-		memcpy(&buf[0] , &bufHeader, sizeof(int32_t));
+	topicInfo.cloudProjector.setCameraModel(cameraModel);
 
-		if(msgSize > BUFFER_SIZE)
+	sensor_msgs::PointCloud2Ptr cloud = topicInfo.pointCloudPool.acquire();
+
+	if(!topicInfo.cloudProjector.project(depth, *cloud))
+	{
+		if(!topicInfo.isCloudMismatchReported)
 		{
-			close(dstSocket);
-			std::cout << "Data size is too big. tid=" << gettid() << std::endl;
-			break;
+			std::cout << "Cannot project " << topicValue << " (" << depth.encoding << " " << depth.width << "x" << depth.height
+			          << ") with " << topicInfo.cloudCameraInfoTopic << std::endl;
+			topicInfo.isCloudMismatchReported = true;
 		}
+		return;
+	}
 
-//		std::cout << "msg size=" << msgSize << std::endl;
+	topicInfo.cloudPublisher.publish(cloud);
+}
 
-		// Get BSON data
-		while(msgSize!=totalReceivedSize)
-		{
-			size_t unreceivedSize = msgSize - (size_t)totalReceivedSize;
+void SIGVerseROSBridge::publishDepthScan(TopicInfo &topicInfo, const std::string &topicValue, const sensor_msgs::Image &depth)
+{
+	// Extracted only while somebody listens
+	if(topicInfo.scanOutput==NULL || topicInfo.scanPublisher.getNumSubscribers()==0){ return; }
 
-			if(!checkReceivable(dstSocket)){ break; }
+	CameraModel cameraModel;
 
-			long int receivedSize = read(dstSocket, &(buf[totalReceivedSize]), unreceivedSize);
+	if(!getCameraModel(topicInfo.scanOutput->cameraInfoTopic, cameraModel)){ return; }
 
-			totalReceivedSize += receivedSize;
+	topicInfo.scanConverter.setCameraModel(cameraModel, topicInfo.scanOutput->settings);
 
-//			std::cout << "receivedSize=" << receivedSize << std::endl;
-		}
+	sensor_msgs::LaserScanPtr scan = topicInfo.laserScanPool.acquire();
 
-		if(msgSize!=totalReceivedSize)
+	if(!topicInfo.scanConverter.convert(depth, *scan))
+	{
+		if(!topicInfo.isScanMismatchReported)
 		{
-			std::cout << "msgSize!=totalReceivedSize ?????? tid=" << gettid() << std::endl;
-			continue;
-		};
+			std::cout << "Cannot extract a scan from " << topicValue << " (" << depth.encoding << " " << depth.width << "x" << depth.height
+			          << ") with " << topicInfo.scanOutput->cameraInfoTopic << std::endl;
+			topicInfo.isScanMismatchReported = true;
+		}
+		return;
+	}
 
+	scan->header.frame_id = topicInfo.scanOutput->frameId;
 
-		bsoncxx::document::view bsonView((const uint8_t*)buf, (std::size_t)msgSize);
+	topicInfo.scanPublisher.publish(scan);
+}
 
-		bsoncxx::builder::core bsonCore(false);
+void SIGVerseROSBridge::publishScanCloud(TopicInfo &topicInfo, const sensor_msgs::LaserScan &scan)
+{
+	// Projected only while somebody listens
+	if(!topicInfo.cloudPublisher || topicInfo.cloudPublisher.getNumSubscribers()==0){ return; }
 
-		bsonCore.concatenate(bsonView);
+	sensor_msgs::PointCloud2Ptr cloud = topicInfo.pointCloudPool.acquire();
 
-		bsoncxx::builder::basic::sub_document bsonSubdocument(&bsonCore);
+	topicInfo.scanCloudProjector.project(scan, *cloud);
 
-		std::string opValue    = bsonView["op"]   .get_utf8().value.to_string();
-		std::string topicValue = bsonView["topic"].get_utf8().value.to_string();
-		std::string typeValue  = bsonView["type"] .get_utf8().value.to_string();
-//		std::cout << "op:" << opValue << std::endl;
-//		std::cout << "tp:" << topicValue << std::endl;
+	topicInfo.cloudPublisher.publish(cloud);
+}
 
-		// Advertise
-		if(publisherMap.count(topicValue)==0 && typeValue!=TYPE_TIME_SYNC && typeValue!=TYPE_TF_LIST)
-		{
-			ros::Publisher publisher;
+bool SIGVerseROSBridge::isWithinDeadband(TfFrameState &frameState, const geometry_msgs::TransformStamped &transformStamped)
+{
+	if(!frameState.isDeadbandResolved)
+	{
+		frameState.deadband           = tfDeadbandTable.get(transformStamped.child_frame_id);
+		frameState.isDeadbandResolved = true;
+	}
 
-			if(typeValue==TYPE_TWIST)
-			{
-				publisher = rosNodeHandle.advertise<geometry_msgs::Twist>(topicValue, 1000);
-			}
-			else if(typeValue==TYPE_CAMERA_INFO)
-			{
-				publisher = rosNodeHandle.advertise<sensor_msgs::CameraInfo>(topicValue, 10);
-			}
-			else if(typeValue==TYPE_IMAGE)
-			{
-				publisher = rosNodeHandle.advertise<sensor_msgs::Image>(topicValue, 10);
-			}
-			else if(typeValue==TYPE_LASER_SCAN)
-			{
-				publisher = rosNodeHandle.advertise<sensor_msgs::LaserScan>(topicValue, 10);
-			}
-			else
-			{
-				std::cout << "Not compatible message type! :" << typeValue << std::endl;
-				continue;
-			}
+	const TfDeadband *deadband = frameState.deadband;
 
-			std::cout << "Advertised " << topicValue << std::endl;
-			publisherMap[topicValue] = publisher;
-		}
+	if(deadband != NULL && frameState.hasPublished && frameState.publishedParentFrameId == transformStamped.header.frame_id)
+	{
+		const geometry_msgs::Transform &transform = transformStamped.transform;
+		const geometry_msgs::Transform &published = frameState.publishedTransform;
 
-		// Publish
-		// Twist
-		if(typeValue==TYPE_TWIST)
-		{
-			geometry_msgs::Twist twist;
+		double dx = transform.translation.x - published.translation.x;
+		double dy = transform.translation.y - published.translation.y;
+		double dz = transform.translation.z - published.translation.z;
 
-			twist.linear.x = bsonView["msg"]["linear"]["x"].get_double();
-			twist.linear.y = bsonView["msg"]["linear"]["y"].get_double();
-			twist.linear.z = bsonView["msg"]["linear"]["z"].get_double();
+		// The rotation angle between two unit quaternions q1 and q2 is 2*acos(|q1.q2|)
+		double dot = transform.rotation.x * published.rotation.x + transform.rotation.y * published.rotation.y +
+		             transform.rotation.z * published.rotation.z + transform.rotation.w * published.rotation.w;
 
-			twist.angular.x = bsonView["msg"]["angular"]["x"].get_double();
-			twist.angular.y = bsonView["msg"]["angular"]["y"].get_double();
-			twist.angular.z = bsonView["msg"]["angular"]["z"].get_double();
+		ros::Duration elapsed = transformStamped.header.stamp - frameState.publishedStamp;
 
-			publisherMap[topicValue].publish(twist);
-		}
-		// CameraInfo
-		else if(typeValue==TYPE_CAMERA_INFO)
-		{
-			sensor_msgs::CameraInfo cameraInfo;
+		bool isWithin =
+			dx*dx + dy*dy + dz*dz <= deadband->translation * deadband->translation &&
+			std::fabs(dot) >= std::cos(deadband->rotation * 0.5) &&
+			elapsed >= ros::Duration(0.0) && // The stamp went back, e.g. the simulation was restarted
+			(deadband->maxInterval <= 0.0 || elapsed.toSec() < deadband->maxInterval);
 
-			cameraInfo.header.seq        = (uint32_t)bsonView["msg"]["header"]["seq"]           .get_int32();
-			cameraInfo.header.stamp.sec  = (uint32_t)bsonView["msg"]["header"]["stamp"]["secs"] .get_int32();
-			cameraInfo.header.stamp.nsec = (uint32_t)bsonView["msg"]["header"]["stamp"]["nsecs"].get_int32();
-			cameraInfo.header.frame_id   =           bsonView["msg"]["header"]["frame_id"]      .get_utf8().value.to_string();
+		if(isWithin){ return true; }
+	}
 
-			cameraInfo.height            = (uint32_t)bsonView["msg"]["height"].get_int32();
-			cameraInfo.width             = (uint32_t)bsonView["msg"]["width"] .get_int32();
-			cameraInfo.distortion_model  =           bsonView["msg"]["distortion_model"].get_utf8().value.to_string();
+	frameState.hasPublished           = true;
+	frameState.publishedParentFrameId = transformStamped.header.frame_id;
+	frameState.publishedTransform     = transformStamped.transform;
+	frameState.publishedStamp         = transformStamped.header.stamp;
 
-			bsoncxx::array::view dView = bsonView["msg"]["D"].get_array().value;
-			cameraInfo.D.resize((size_t)std::distance(dView.cbegin(), dView.cend()));
-			setVectorDouble(cameraInfo.D, dView);
+	return false;
+}
 
-			setArrayDouble(cameraInfo.K, bsonView["msg"]["K"].get_array().value);
-			setArrayDouble(cameraInfo.R, bsonView["msg"]["R"].get_array().value);
-			setArrayDouble(cameraInfo.P, bsonView["msg"]["P"].get_array().value);
+void SIGVerseROSBridge::publishStaticTransforms(const std::vector<geometry_msgs::TransformStamped> &promotedTransforms, const std::vector<std::string> &demotedFrameIds)
+{
+	boost::mutex::scoped_lock lock(staticTransformMutex);
 
-			cameraInfo.binning_x         = (uint32_t)bsonView["msg"]["binning_x"].get_int32();
-			cameraInfo.binning_y         = (uint32_t)bsonView["msg"]["binning_y"].get_int32();
-			cameraInfo.roi.x_offset      = (uint32_t)bsonView["msg"]["roi"]["x_offset"]  .get_int32();
-			cameraInfo.roi.y_offset      = (uint32_t)bsonView["msg"]["roi"]["y_offset"]  .get_int32();
-			cameraInfo.roi.height        = (uint32_t)bsonView["msg"]["roi"]["height"]    .get_int32();
-			cameraInfo.roi.width         = (uint32_t)bsonView["msg"]["roi"]["width"]     .get_int32();
-			cameraInfo.roi.do_rectify    = (uint8_t) bsonView["msg"]["roi"]["do_rectify"].get_bool();
+	if(!staticTransformPublisher)
+	{
+		staticTransformPublisher = nodeHandle.advertise<tf2_msgs::TFMessage>(TF_STATIC_TOPIC, DEFAULT_TF_QUEUE_SIZE, true);
+	}
 
-			publisherMap[topicValue].publish(cameraInfo);
-		}
-		// Image
-		else if(typeValue==TYPE_IMAGE)
-		{
-			sensor_msgs::Image image;
+	for(size_t i=0; i<promotedTransforms.size(); i++)
+	{
+		staticTransforms[promotedTransforms[i].child_frame_id] = promotedTransforms[i];
 
-			image.header.seq        = (uint32_t)bsonView["msg"]["header"]["seq"]           .get_int32();
-			image.header.stamp.sec  = (uint32_t)bsonView["msg"]["header"]["stamp"]["secs"] .get_int32();
-			image.header.stamp.nsec = (uint32_t)bsonView["msg"]["header"]["stamp"]["nsecs"].get_int32();
-			image.header.frame_id   =           bsonView["msg"]["header"]["frame_id"]      .get_utf8().value.to_string();
-			image.height            = (uint32_t)bsonView["msg"]["height"]      .get_int32();
-			image.width             = (uint32_t)bsonView["msg"]["width"]       .get_int32();
-			image.encoding          =           bsonView["msg"]["encoding"]    .get_utf8().value.to_string();
-			image.is_bigendian      = (uint8_t) bsonView["msg"]["is_bigendian"].get_int32(); //.raw()[0];
-			image.step              = (uint32_t)bsonView["msg"]["step"]        .get_int32();
+		std::cout << "Promoted to " << TF_STATIC_TOPIC << ". frame=" << promotedTransforms[i].child_frame_id << std::endl;
+	}
 
-			size_t sizet = (image.step * image.height);
-			image.data.resize(sizet);
-			memcpy(&image.data[0], bsonView["msg"]["data"].get_binary().bytes, sizet);
+	for(size_t i=0; i<demotedFrameIds.size(); i++)
+	{
+		staticTransforms.erase(demotedFrameIds[i]);
 
-			publisherMap[topicValue].publish(image);
-		}
-		// LaserScan
-		else if(typeValue==TYPE_LASER_SCAN)
-		{
-			sensor_msgs::LaserScan laserScan;
+		std::cout << "Demoted from " << TF_STATIC_TOPIC << ". frame=" << demotedFrameIds[i] << std::endl;
+	}
 
-			laserScan.header.seq        = (uint32_t)bsonView["msg"]["header"]["seq"]           .get_int32();
-			laserScan.header.stamp.sec  = (uint32_t)bsonView["msg"]["header"]["stamp"]["secs"] .get_int32();
-			laserScan.header.stamp.nsec = (uint32_t)bsonView["msg"]["header"]["stamp"]["nsecs"].get_int32();
-			laserScan.header.frame_id   =           bsonView["msg"]["header"]["frame_id"]      .get_utf8().value.to_string();
+	// A latched topic keeps only the last message, so every static transform is sent each time
+	tf2_msgs::TFMessagePtr tfMessage = boost::make_shared<tf2_msgs::TFMessage>();
 
-			laserScan.angle_min       = (float)bsonView["msg"]["angle_min"]      .get_double();
-			laserScan.angle_max       = (float)bsonView["msg"]["angle_max"]      .get_double();
-			laserScan.angle_increment = (float)bsonView["msg"]["angle_increment"].get_double();
-			laserScan.time_increment  = (float)bsonView["msg"]["time_increment"] .get_double();
-			laserScan.scan_time       = (float)bsonView["msg"]["scan_time"]      .get_double();
-			laserScan.range_min       = (float)bsonView["msg"]["range_min"]      .get_double();
-			laserScan.range_max       = (float)bsonView["msg"]["range_max"]      .get_double();
+	tfMessage->transforms.reserve(staticTransforms.size());
 
-			size_t sizet = (size_t)((laserScan.angle_max - laserScan.angle_min) / laserScan.angle_increment + 1);
+	for(auto itr = staticTransforms.begin(); itr != staticTransforms.end(); ++itr)
+	{
+		tfMessage->transforms.push_back(itr->second);
+	}
 
-			laserScan.ranges.resize(sizet);
-			laserScan.intensities.resize(sizet);
+	staticTransformPublisher.publish(tfMessage);
+}
 
-			bsoncxx::array::view dView_ranges = bsonView["msg"]["ranges"].get_array().value;
-			laserScan.ranges.resize(std::distance(dView_ranges.cbegin(), dView_ranges.cend()));
-			setVectorFloat(laserScan.ranges, dView_ranges);
+bool SIGVerseROSBridge::shouldDrop(TopicInfo &topicInfo, const Frame &frame, const ClockConversion &clockConversion)
+{
+	// A newer frame of the same topic is already waiting
+	if(frame.isSuperseded && topicInfo.policy.keepLatest)
+	{
+		topicInfo.supersededDropNum++;
+		return true;
+	}
 
-			bsoncxx::array::view dView_intensities = bsonView["msg"]["intensities"].get_array().value;
-			laserScan.intensities.resize(std::distance(dView_intensities.cbegin(), dView_intensities.cend()));
-			setVectorFloat(laserScan.intensities, dView_intensities);
+	// Rate and age are checked with the header stamp, which Twist and TF lists do not have
+	if(frame.type==TYPE_TWIST || frame.type==TYPE_TF_LIST){ return false; }
 
-			publisherMap[topicValue].publish(laserScan);
-		}
-		// Time Synchronization (SIGVerse Original Type)
-		else if(typeValue==TYPE_TIME_SYNC)
-		{
-			if(syncTimeCnt < syncTimeMaxNum)
-			{
-				ros::Time timestamp;
+	if(topicInfo.policy.maxRate <= 0.0 && topicInfo.policy.maxAge <= 0.0){ return false; }
 
-				timestamp.sec  = (uint32_t)bsonView["msg"]["data"]["secs"] .get_int32();
-				timestamp.nsec = (uint32_t)bsonView["msg"]["data"]["nsecs"].get_int32();
+	ros::Time stamp = getFrameStamp(frame);
 
-				ros::Time now = ros::Time::now();
+	clockConversion.toRosTime(stamp);
 
-				int gapSec  = ((int)timestamp.sec  - (int)now.sec);
-				int gapMsec = ((int)timestamp.nsec - (int)now.nsec) /1000 /1000;
+	ros::Time now = ros::Time::now();
 
-				std::string timeGap = "time_gap," + std::to_string(gapSec) + "," + std::to_string(gapMsec);
+	if(stamp.isZero()){ stamp = now; }
 
-				ssize_t size = write(dstSocket, timeGap.c_str(), std::strlen(timeGap.c_str()));
+	if(topicInfo.policy.maxAge > 0.0 && (now - stamp).toSec() > topicInfo.policy.maxAge)
+	{
+		topicInfo.ageDropNum++;
+		return true;
+	}
 
-				std::cout << "TYPE_TIME_SYNC " << timeGap.c_str() << std::endl;
+	if(topicInfo.policy.maxRate > 0.0)
+	{
+		ros::Duration period(1.0 / topicInfo.policy.maxRate);
 
-				syncTimeCnt++;
-			}
-		}
-		// Tf list data (SIGVerse Original Type)
-		else if(typeValue==TYPE_TF_LIST)
+		ros::Duration untilNextPublish = topicInfo.nextPublishStamp - stamp;
+
+		// The stamp went back (e.g. the simulation was restarted)
+		if(untilNextPublish > period)
 		{
-			static tf::TransformBroadcaster transformBroadcaster;
+			topicInfo.nextPublishStamp = stamp;
+			untilNextPublish = ros::Duration(0.0);
+		}
 
-			bsoncxx::array::view tfArrayView = bsonView["msg"].get_array().value;
+		// Up to 10% of the period early is accepted, so that the jitter of the frame stamps does not lower the rate
+		if(untilNextPublish > period * 0.1)
+		{
+			topicInfo.rateDropNum++;
+			return true;
+		}
 
-			std::vector<tf::StampedTransform> stampedTransformList;
+		// Keep the publishing times on the grid of the period unless falling behind it
+		if(topicInfo.nextPublishStamp + period > stamp)
+		{
+			topicInfo.nextPublishStamp = topicInfo.nextPublishStamp + period;
+		}
+		else
+		{
+			topicInfo.nextPublishStamp = stamp + period;
+		}
+	}
 
-			int i = 0;
+	return false;
+}
 
-			for(auto itr = tfArrayView.cbegin(); itr != tfArrayView.cend(); ++itr)
-			{
-				ros::Time timestamp;
-				std::string tfPrefix     = "simulated/";
-				std::string frameId      = tfPrefix + ((*itr)["header"]["frame_id"].get_utf8().value.to_string());
-				timestamp.sec            = (*itr)["header"]["stamp"]["secs"] .get_int32();
-				timestamp.nsec           = (*itr)["header"]["stamp"]["nsecs"].get_int32();
-				std::string childFrameId = tfPrefix + ((*itr)["child_frame_id"]    .get_utf8().value.to_string());
-
-				if(timestamp.sec == 0)
-				{
-					timestamp = ros::Time::now();
-				}
+void SIGVerseROSBridge::publishClock(const ros::Time &clock)
+{
+	boost::mutex::scoped_lock lock(clockMutex);
 
-				tf::Vector3 position = tf::Vector3
-				(
-					(double)(*itr)["transform"]["translation"]["x"].get_double(),
-					(double)(*itr)["transform"]["translation"]["y"].get_double(),
-					(double)(*itr)["transform"]["translation"]["z"].get_double()
-				);
+	if(!clockPublisher)
+	{
+		clockPublisher = nodeHandle.advertise<rosgraph_msgs::Clock>(CLOCK_TOPIC, DEFAULT_CLOCK_QUEUE_SIZE);
+		std::cout << "Advertised " << CLOCK_TOPIC << std::endl;
+	}
 
-				tf::Quaternion quaternion = tf::Quaternion
-				(
-					(double)(*itr)["transform"]["rotation"]["x"].get_double(),
-					(double)(*itr)["transform"]["rotation"]["y"].get_double(),
-					(double)(*itr)["transform"]["rotation"]["z"].get_double(),
-					(double)(*itr)["transform"]["rotation"]["w"].get_double()
-				);
+	if(!lastClock.isZero() && clock <= lastClock)
+	{
+		// Restarted. Nodes on simulator time reset themselves when the clock jumps back.
+		if((lastClock - clock).toSec() > clockResetThreshold)
+		{
+			std::cout << "Clock went back. Restarted? from=" << lastClock << " to=" << clock << std::endl;
+		}
+		// Duplicated or reordered
+		else
+		{
+			// Every drop is counted. Only the message is rate-limited.
+			if((clockDropNum++ % CLOCK_DROP_REPORT_INTERVAL) == 0)
+			{
+				std::cout << "Clock did not advance. Dropped. drops=" << clockDropNum << std::endl;
+			}
+			return;
+		}
+	}
 
-				tf::Transform transform;
-				transform.setOrigin(position);
-				transform.setRotation(quaternion);
+	lastClock = clock;
 
-				stampedTransformList.push_back(tf::StampedTransform(transform, timestamp, frameId, childFrameId));
-			}
+	rosgraph_msgs::ClockPtr clockMessage = boost::make_shared<rosgraph_msgs::Clock>();
+	clockMessage->clock = clock;
 
-			transformBroadcaster.sendTransform(stampedTransformList);
-		}
+	clockPublisher.publish(clockMessage);
+}
 
-//		std::cout << "published. topic=" << topicValue << std::endl;
+void SIGVerseROSBridge::publishClockQuality(Connection &connection)
+{
+	if(ros::WallTime::now() - connection.clockQualityTime < ros::WallDuration(CLOCK_QUALITY_INTERVAL)){ return; }
 
-		ros::spinOnce();
+	connection.clockQualityTime = ros::WallTime::now();
 
-//		loop_rate.sleep();
-	}
+	ClockQuality quality = connection.clockSync.getQuality();
 
-	delete[] buf;
+	diagnostic_msgs::DiagnosticArrayPtr diagnosticArray = boost::make_shared<diagnostic_msgs::DiagnosticArray>();
 
-	return NULL;
-}
+	diagnosticArray->header.stamp = ros::Time::now();
+	diagnosticArray->status.resize(1);
 
+	diagnostic_msgs::DiagnosticStatus &status = diagnosticArray->status[0];
 
-int SIGVerseROSBridge::run(int argc, char **argv)
-{
-	uint16_t portNumber;
+	status.name        = "sigverse_ros_bridge: clock sync fd=" + std::to_string(connection.dstSocket);
+	status.hardware_id = "sigverse";
 
-	// Set port number
-	if(argc > 1)
+	if(!quality.isSynchronized)
+	{
+		status.level   = diagnostic_msgs::DiagnosticStatus::WARN;
+		status.message = "No sample";
+	}
+	else if(quality.jitter > CLOCK_SYNC_MAX_JITTER)
 	{
-		portNumber = (uint16_t)std::atoi(argv[1]);
+		status.level   = diagnostic_msgs::DiagnosticStatus::WARN;
+		status.message = "Large jitter";
 	}
 	else
 	{
-		portNumber = DEFAULT_PORT;
+		status.level   = diagnostic_msgs::DiagnosticStatus::OK;
+		status.message = quality.isRoundTrip ? "Round-trip" : "One-way (includes the network delay)";
 	}
 
-	if(argc > 2)
+	const char *keys[]   = { "offset [s]", "drift [ppm]", "delay [s]", "jitter [s]", "samples" };
+	std::string values[] = { std::to_string(quality.offset), std::to_string(quality.drift), std::to_string(quality.delay), std::to_string(quality.jitter), std::to_string(quality.sampleNum) };
+
+	status.values.resize(sizeof(keys) / sizeof(keys[0]));
+
+	for(size_t i=0; i<status.values.size(); i++)
 	{
-		syncTimeMaxNum = (uint16_t)std::atoi(argv[2]);
+		status.values[i].key   = keys[i];
+		status.values[i].value = values[i];
 	}
-	else
+
+	diagnosticsPublisher.publish(diagnosticArray);
+}
+
+void SIGVerseROSBridge::reportDrops(std::map<std::string, TopicInfo> &topicInfoMap)
+{
+	for(auto itr = topicInfoMap.begin(); itr != topicInfoMap.end(); ++itr)
 	{
-		syncTimeMaxNum = DEFAULT_SYNC_TIME_MAX_NUM;
+		TopicInfo &topicInfo = itr->second;
+
+		uint64_t dropNum = topicInfo.supersededDropNum + topicInfo.rateDropNum + topicInfo.ageDropNum + topicInfo.deadbandDropNum + topicInfo.encoderDropNum;
+
+		if(dropNum == topicInfo.reportedDropNum){ continue; }
+
+		std::cout << "Dropped frames. topic=" << itr->first << " superseded=" << topicInfo.supersededDropNum
+		          << " rate=" << topicInfo.rateDropNum << " age=" << topicInfo.ageDropNum << " deadband=" << topicInfo.deadbandDropNum
+		          << " encoder=" << topicInfo.encoderDropNum << " tid=" << gettid() << std::endl;
+
+		topicInfo.reportedDropNum = dropNum;
 	}
+}
+
 
+int SIGVerseROSBridge::run()
+{
 	isRunning = true;
 	syncTimeCnt = 0;
 
+	listenerTuning.apply("listener");
+
 	int srcSocket;
 	struct sockaddr_in srcAddr;
 
@@ -436,48 +1844,146 @@ int SIGVerseROSBridge::run(int argc, char **argv)
 	srcAddr.sin_family = AF_INET;
 	srcAddr.sin_addr.s_addr = INADDR_ANY;
 
-	srcSocket = socket(AF_INET, SOCK_STREAM, 0);
+	srcSocket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
 
 	bind(srcSocket, (struct sockaddr *)&srcAddr, sizeof(srcAddr));
 
 	listen(srcSocket, 100);
 
+	// One reactor thread accepts, receives and replies for every connection
+	epollFd = epoll_create1(0);
+	wakeFd  = eventfd(0, EFD_NONBLOCK);
+
+	struct epoll_event event;
+
+	event.events  = EPOLLIN;
+	event.data.fd = srcSocket;
+	epoll_ctl(epollFd, EPOLL_CTL_ADD, srcSocket, &event);
+
+	event.events  = EPOLLIN;
+	event.data.fd = wakeFd;
+	epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+
+	encodePool.reset(new EncodePool(encodeWorkerNum, (size_t)std::max(encodeQueueSize, 1), boost::bind(&SIGVerseROSBridge::initEncodeWorker, this, _1)));
+
+	if(usePriorityLanes)
+	{
+		decodePool.reset(new WorkStealingPool(decodeWorkerNum, boost::bind(&SIGVerseROSBridge::initDecodeWorker, this, _1)));
+	}
+
 	std::cout << "Waiting for connection... port=" << portNumber << std::endl;
 
-	while(isRunning)
+	struct epoll_event events[REACTOR_MAX_EVENT_NUM];
+
+	ros::WallTime idleCheckTime = ros::WallTime::now();
+
+	while(isRunning && ros::ok())
 	{
-		int dstSocket;
+		int timeout = closedConnections.empty() ? REACTOR_TIMEOUT : REACTOR_CLOSING_TIMEOUT;
 
-		struct sockaddr_in dstAddr;
-		int dstAddrSize = sizeof(dstAddr);
+		int eventNum = epoll_wait(epollFd, events, REACTOR_MAX_EVENT_NUM, timeout);
 
-		if(!checkReceivable(srcSocket))
+		for(int i=0; i<eventNum; i++)
 		{
-			continue;
+			int fd = events[i].data.fd;
+
+			if(fd == srcSocket)
+			{
+				acceptConnections(srcSocket);
+				continue;
+			}
+
+			if(fd == wakeFd)
+			{
+				uint64_t count;
+				ssize_t size = read(wakeFd, &count, sizeof(count));
+				(void)size;
+
+				// Released frames and queued replies
+				std::vector<boost::shared_ptr<Connection> > wokenConnections;
+
+				for(auto itr = connections.begin(); itr != connections.end(); ++itr)
+				{
+					wokenConnections.push_back(itr->second);
+				}
+
+				for(size_t j=0; j<wokenConnections.size(); j++)
+				{
+					Connection &connection = *wokenConnections[j];
+
+					flushOutput(connection);
+
+					if(connection.isReadPaused)
+					{
+						connection.isReadPaused = false;
+						updateEvents(connection);
+
+						if(!handleReadable(connection)){ closeConnection(wokenConnections[j]); }
+					}
+				}
+				continue;
+			}
+
+			std::map<int, boost::shared_ptr<Connection> >::iterator connectionItr = connections.find(fd);
+
+			// Closed by an earlier event of this round
+			if(connectionItr == connections.end()){ continue; }
+
+			boost::shared_ptr<Connection> connection = connectionItr->second;
+
+			if(events[i].events & EPOLLOUT)
+			{
+				flushOutput(*connection);
+			}
+
+			if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+			{
+				bool isOpen = connection->isReadPaused ? !(events[i].events & (EPOLLHUP | EPOLLERR)) : handleReadable(*connection);
+
+				if(!isOpen){ closeConnection(connection); }
+			}
 		}
 
-		dstSocket = accept(srcSocket, (struct sockaddr *)&dstAddr, (socklen_t *)&dstAddrSize);
+		finishClosedConnections(false);
 
-		std::cout << "Connected from IP=" << inet_ntoa(dstAddr.sin_addr) << " Port=" << dstAddr.sin_port << std::endl;
+		// The reactor wakes up at least every REACTOR_TIMEOUT
+		if(ros::WallTime::now() - idleCheckTime > ros::WallDuration(FRAME_BUFFER_IDLE_TIME))
+		{
+			releaseIdleBuffers();
+
+			idleCheckTime = ros::WallTime::now();
+		}
+	}
 
-		pthread_t thread;
-		pthread_create( &thread, NULL, receivingThread, (void *)(&dstSocket));
-		pthread_detach(thread);
+	isRunning = false;
+
+	if(!connections.empty())
+	{
+		std::cout << "Sockets closed by shutdown. num=" << connections.size() << std::endl;
+	}
 
-		usleep(10 * 1000);
+	while(!connections.empty())
+	{
+		closeConnection(connections.begin()->second);
 	}
 
+	finishClosedConnections(true);
+
+	decodePool.reset();
+	encodePool.reset();
+
 	close(srcSocket);
+	close(wakeFd);
+	close(epollFd);
+
+	wakeFd  = -1;
+	epollFd = -1;
 
 	return 0;
 }
 
-
-int main(int argc, char **argv)
+void SIGVerseROSBridge::stop()
 {
-	std::cout << "pid=" << getpid() << std::endl;
-
-	SIGVerseROSBridge sigverseROSBridge;
-	sigverseROSBridge.run(argc, argv);
-};
+	isRunning = false;
+}
 
@@ -4,17 +4,27 @@
 #include <stdio.h>
 #include <string.h>
 #include <cstdlib>
+#include <cmath>
 #include <iostream>
 #include <sstream>
 #include <map>
+#include <unordered_map>
+#include <functional>
 
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <pthread.h>
 #include <signal.h>
+#include <atomic>
+#include <vector>
+#include <deque>
 
 #include <ros/ros.h>
 #include <std_msgs/String.h>
@@ -23,7 +33,12 @@
 #include <sensor_msgs/CameraInfo.h>
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/LaserScan.h>
-#include <tf/transform_broadcaster.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <tf2_msgs/TFMessage.h>
+#include <rosgraph_msgs/Clock.h>
+#include <sigverse_ros_bridge/SensorBundle.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <image_transport/image_transport.h>
 
 #include <bsoncxx/array/view.hpp>
 #include <bsoncxx/builder/basic/sub_document.hpp>
@@ -39,6 +54,24 @@
 #include <bsoncxx/types/value.hpp>
 
 #include <boost/array.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread.hpp>
+
+#include "blocking_queue.hpp"
+#include "clock_sync.hpp"
+#include "depth_conversion.hpp"
+#include "encode_pool.hpp"
+#include "image_conversion.hpp"
+#include "scan_conversion.hpp"
+#include "sensor_output_table.hpp"
+#include "frame_id_table.hpp"
+#include "image_pyramid.hpp"
+#include "latency_stats.hpp"
+#include "message_pool.hpp"
+#include "spsc_ring.hpp"
+#include "thread_tuning.hpp"
+#include "topic_policy.hpp"
+#include "work_stealing_pool.hpp"
 
 #define TYPE_TWIST        "geometry_msgs/Twist"
 #define TYPE_CAMERA_INFO  "sensor_msgs/CameraInfo"
@@ -46,34 +79,453 @@
 #define TYPE_LASER_SCAN   "sensor_msgs/LaserScan"
 #define TYPE_TIME_SYNC    "sigverse/TimeSync"
 #define TYPE_TF_LIST      "sigverse/TfList"
+#define TYPE_CLOCK        "sigverse/Clock"
+#define TYPE_SENSOR_BUNDLE "sigverse/SensorBundle"
 
 #define BUFFER_SIZE 25*1024*1024 //100MB
 
 #define DEFAULT_PORT 50001
 #define DEFAULT_SYNC_TIME_MAX_NUM 1
 
+#define DEFAULT_TWIST_QUEUE_SIZE  1000
+#define DEFAULT_SENSOR_QUEUE_SIZE 10
+#define DEFAULT_TF_QUEUE_SIZE     100
+
+#define TF_TOPIC        "/tf"
+#define TF_STATIC_TOPIC "/tf_static"
+#define DEFAULT_TF_PREFIX "simulated/"
+
+#define PYRAMID_MAX_LEVEL_NUM 2 // half and quarter
+
+#define DEFAULT_ENCODE_WORKER_NUM 2
+#define DEFAULT_ENCODE_QUEUE_SIZE 2 // Encode jobs waiting for a worker. Further frames are skipped.
+
+#define MAX_FRAME_NUM 16 // per connection
+#define DEFAULT_FRAME_BUFFER_LIMIT 64  //[MB] Capacity of the frame buffers a connection keeps between frames
+#define FRAME_BUFFER_IDLE_TIME     5.0 //[s] A connection that receives nothing for this long frees its frame buffers
+#define STATS_REPORT_INTERVAL 10.0 //[s]
+
+#define CLOCK_TOPIC            "/clock"
+#define DEFAULT_CLOCK_QUEUE_SIZE 10
+#define DEFAULT_CLOCK_RESET_THRESHOLD 1.0 //[s]
+#define CLOCK_DROP_REPORT_INTERVAL 100 // Every this many drops of duplicated or reordered clock frames
+
+#define DIAGNOSTICS_TOPIC      "/diagnostics"
+#define CLOCK_QUALITY_INTERVAL 1.0   //[s]
+#define CLOCK_SYNC_MAX_JITTER  0.005 //[s] Above this the clock sync is reported as a warning
+
+#define SHUTDOWN_POLL_INTERVAL 1000 //[us]
+
+#define REACTOR_MAX_EVENT_NUM  64
+#define REACTOR_TIMEOUT        1000 //[ms]
+#define REACTOR_CLOSING_TIMEOUT  10 //[ms] While closed connections wait for their frames to be processed
+#define REACTOR_FRAME_BUDGET      4 // Frames received from a connection at a time, so that a busy connection does not starve the others
+
 class SIGVerseROSBridge
 {
 private:
+	enum ReceiveResult
+	{
+		RECEIVE_OK,
+		RECEIVE_INCOMPLETE, // The rest has not arrived yet
+		RECEIVE_CLOSED,
+	};
+
+	enum BundlePart
+	{
+		BUNDLE_RGB,
+		BUNDLE_DEPTH,
+		BUNDLE_CAMERA_INFO,
+		BUNDLE_PART_NUM,
+	};
+
+	struct TopicStrand;
+
+	struct Frame
+	{
+		std::vector<uint8_t> buffer;
+
+		bsoncxx::document::view bsonView;
+
+		std::string topic;
+		std::string type;
+
+		bool isSuperseded; // A newer frame of the same topic has already been received
+
+		ros::WallTime receivedTime;
+
+		// Bundle parts only. A part is a view into the buffer of its bundle frame and is processed as a frame of its own topic.
+		Frame      *bundleFrame;
+		BundlePart  bundlePart;
+
+		// Bundle frames only. The bundle frame goes to the strand of the bundle topic when its parts are finished.
+		boost::shared_ptr<Frame>   bundleParts[BUNDLE_PART_NUM]; // Reused with the frame
+		std::atomic<int>           unfinishedPartNum;
+		TopicStrand               *bundleStrand;     // NULL when the parts are processed in the lane of the bundle
+		sensor_msgs::ImagePtr      bundleRgb;        // Set by the parts
+		sensor_msgs::ImagePtr      bundleDepth;
+		sensor_msgs::CameraInfoPtr bundleCameraInfo;
+
+		Frame() : isSuperseded(false), bundleFrame(NULL), bundlePart(BUNDLE_RGB), unfinishedPartNum(0), bundleStrand(NULL) {}
+	};
+
+	// The latest transform of a child frame in a TF list
+	struct TfFrameState
+	{
+		std::string              parentFrameId;
+		geometry_msgs::Transform transform;
+
+		int  unchangedNum; // Consecutive TF lists in which the transform was identical
+		bool isStatic;     // Published on /tf_static instead of /tf
+
+		// The transform last published on /tf, for the deadband
+		const TfDeadband        *deadband; // NULL if no deadband applies
+		bool                     isDeadbandResolved;
+		bool                     hasPublished;
+		std::string              publishedParentFrameId;
+		geometry_msgs::Transform publishedTransform;
+		ros::Time                publishedStamp;
+
+		TfFrameState() : unchangedNum(0), isStatic(false), deadband(NULL), isDeadbandResolved(false), hasPublished(false) {}
+	};
+
+	// Publisher of the image_transport plugins of an image topic, shared with its encode job in flight
+	struct CompressedOutput
+	{
+		image_transport::Publisher publisher; // Without the raw transport, which the topic publisher serves
+		std::atomic<bool>          isEncoding; // A frame is queued or being encoded. Newer frames are skipped meanwhile.
+
+		CompressedOutput() : isEncoding(false) {}
+	};
+
+	struct TopicInfo
+	{
+		ros::Publisher publisher;
+		TopicPolicy    policy;
+
+		// Published messages are recycled per topic
+		MessagePool<sensor_msgs::CameraInfo> cameraInfoPool;
+		MessagePool<sensor_msgs::Image>      imagePool;
+		MessagePool<sensor_msgs::LaserScan>  laserScanPool;
+		MessagePool<tf2_msgs::TFMessage>     tfMessagePool;
+
+		// CameraInfo only. The last decoded message without its header.
+		sensor_msgs::CameraInfo cameraInfoBody;
+		uint64_t                cameraInfoBodyHash;
+		bool                    hasCameraInfoBody;
+		std::string             cameraModelTopic; // Resolved. Empty unless a depth output uses it.
+
+		// Depth images and laser scans with a point cloud output only
+		ros::Publisher      cloudPublisher;
+		MessagePool<sensor_msgs::PointCloud2> pointCloudPool;
+		std::string         cloudCameraInfoTopic; // Resolved. Depth images only.
+		DepthCloudProjector cloudProjector;
+		bool                isCloudMismatchReported;
+		ScanCloudProjector  scanCloudProjector;
+
+		// Depth images with a laser scan output only
+		ros::Publisher         scanPublisher;
+		const DepthScanOutput *scanOutput;
+		DepthScanConverter     scanConverter;
+		bool                   isScanMismatchReported;
+
+		// TF lists only
+		FrameIdTable frameIdTable; // Prefixed with the TF prefix
+		std::unordered_map<std::string, TfFrameState> tfFrameStates; // Keyed by child frame id
+
+		bool isImageTransformReported; // Images only. The image transform of the policy failed once.
+
+		// Images with pyramid outputs only. Level 0 is the half and level 1 is the quarter.
+		ros::Publisher                  pyramidPublishers[PYRAMID_MAX_LEVEL_NUM];
+		MessagePool<sensor_msgs::Image> pyramidPools[PYRAMID_MAX_LEVEL_NUM];
+		bool                            isPyramidReported;
+
+		boost::shared_ptr<CompressedOutput> compressedOutput; // Images published through image_transport only
+
+		ros::Time nextPublishStamp;
+
+		uint64_t supersededDropNum;
+		uint64_t rateDropNum;
+		uint64_t ageDropNum;
+		uint64_t deadbandDropNum; // Transforms, not frames
+		uint64_t encoderDropNum;  // Frames not compressed since the encoders were busy
+		uint64_t reportedDropNum;
+
+		TopicInfo(const ros::Publisher &publisher, const TopicPolicy &policy)
+			: publisher(publisher), policy(policy), cameraInfoBodyHash(0), hasCameraInfoBody(false), isCloudMismatchReported(false), scanOutput(NULL), isScanMismatchReported(false), isImageTransformReported(false), isPyramidReported(false), supersededDropNum(0), rateDropNum(0), ageDropNum(0), deadbandDropNum(0), encoderDropNum(0), reportedDropNum(0) {}
+	};
+
+	enum FrameResult
+	{
+		FRAME_DROPPED,
+		FRAME_DECODED,   // The message is in the publish item
+		FRAME_PROCESSED, // Answered or published while processing (time sync, clock and sensor bundle)
+	};
+
+	// A decoded message on its way to the publisher
+	struct PublishItem
+	{
+		const ros::Publisher *publisher;
+
+		geometry_msgs::TwistPtr    twist;
+		sensor_msgs::CameraInfoPtr cameraInfo;
+		sensor_msgs::ImagePtr      image;
+		sensor_msgs::LaserScanPtr  laserScan;
+		tf2_msgs::TFMessagePtr     tfMessage;
+
+		ros::WallTime receivedTime;
+
+		PublishItem() : publisher(NULL) {}
+	};
+
+	// Frames of the control lane are processed in order in its own thread
+	struct Lane
+	{
+		std::string name;
+
+		SpscRing<Frame *> frameRing;
+		boost::shared_ptr<boost::thread> thread;
+		std::atomic<bool> isFinished; // The ring is closed and drained
+
+		std::map<std::string, TopicInfo> topicInfoMap;
+
+		LatencyStats frameLatency;
+		LatencyStats tfLatency;
+
+		Lane(const std::string &name) : name(name), frameRing(MAX_FRAME_NUM), isFinished(false) {}
+	};
+
+	// A reply queued by a lane. The t3 of a time sync reply is taken by the reactor when the reply is written.
+	struct Reply
+	{
+		std::string text;       // Unless a time sync reply
+		bool        isTimeSync;
+		ros::Time   t1;         // Sent by the client
+		ros::Time   t2;         // Received by the bridge
+
+		Reply() : isTimeSync(false) {}
+	};
+
+	struct Connection;
+
+	// Frames of a sensor topic, processed in order by one worker of the decode pool at a time
+	struct TopicStrand : public WorkStealingTask
+	{
+		SIGVerseROSBridge *bridge;
+		Connection        *connection;
+
+		boost::mutex        mutex;
+		std::deque<Frame *> frames;
+		bool                isScheduled; // Submitted to the decode pool and not finished yet
+
+		std::map<std::string, TopicInfo> topicInfoMap;
+
+		LatencyStats  latency;
+		ros::WallTime reportTime;
+
+		TopicStrand(SIGVerseROSBridge *bridge, Connection *connection)
+			: bridge(bridge), connection(connection), isScheduled(false), reportTime(ros::WallTime::now()) {}
+
+		void run() { bridge->processStrand(this); }
+	};
+
+	enum ReceiveState
+	{
+		RECEIVE_HEADER, // Waiting for the 4-byte BSON size
+		RECEIVE_BODY,
+	};
+
+	// A connection is driven by the reactor thread as a state machine.
+	// Only the reactor reads and writes the socket, so an idle connection costs no thread.
+	struct Connection
+	{
+		int dstSocket;
+
+		// Receiving state. Touched only by the reactor.
+		ReceiveState receiveState;
+		char         header[4];
+		int32_t      msgSize;
+		size_t       receivedSize;   // Of the current frame including the header
+		Frame       *receivingFrame;
+		bool         isReadPaused;   // Every frame is in use. Reading resumes when one of them is released.
+		bool         isWriting;      // Waiting for the socket to become writable
+
+		BlockingQueue<Frame *> freeFrames;
+		int allocatedFrameNum;
+		std::atomic<bool> isWaitingForFrame;
+
+		std::atomic<size_t> bufferCapacity;   // Of the buffers of all its frames
+		ros::WallTime       lastReceivedTime; // Of the last frame. Touched only by the reactor.
+
+		// Replies queued by the lanes and written by the reactor
+		boost::mutex      outputMutex;
+		std::deque<Reply> replies;
+		std::string       outputBuffer; // Formatted replies being written
+
+		boost::shared_ptr<Lane> controlLane; // Twist, TF list and time sync. Started with the first control frame.
+
+		ClockSync     clockSync;
+		ros::WallTime clockQualityTime; // When the clock quality was last published
+
+		std::map<std::string, boost::shared_ptr<TopicStrand> > topicStrands; // Sensor messages
+		std::atomic<int> scheduledStrandNum;
+
+		Connection(int dstSocket)
+			: dstSocket(dstSocket), receiveState(RECEIVE_HEADER), msgSize(0), receivedSize(0), receivingFrame(NULL), isReadPaused(false), isWriting(false),
+			  allocatedFrameNum(0), isWaitingForFrame(false), bufferCapacity(0), lastReceivedTime(ros::WallTime::now()), scheduledStrandNum(0) {}
+	};
+
 	static pid_t gettid(void);
 
-	static void rosSigintHandler(int sig);
-	static bool checkReceivable( int fd );
+	static bool isControlType(const std::string &type);
 
 	static void setVectorDouble(std::vector<double> &destVec, const bsoncxx::array::view &arrayView);
 	static void setVectorFloat (std::vector<float>  &destVec, const bsoncxx::array::view &arrayView);
 
+	static ros::Time getTime(const bsoncxx::document::element &element); // {secs, nsecs}
+	static void setFrameId(std::string &frameId, const bsoncxx::document::element &element);
+
+	// Hash of the raw bytes of every element but the skipped one
+	static uint64_t hashElements(const bsoncxx::document::view &documentView, const char *skippedKey);
+
 	template < size_t ArrayNum >
 	static void setArrayDouble(boost::array<double, ArrayNum> &vec, const bsoncxx::array::view &arrayView);
 
-	static void *receivingThread(void *param);
+	void acceptConnections(int srcSocket);
+	bool handleReadable(Connection &connection);
+	ReceiveResult readSocket(Connection &connection, uint8_t *buffer, size_t size);
+	bool startFrame(Connection &connection);
+	void finishFrame(Connection &connection);
+	Frame *acquireFrame(Connection &connection);
+	void releaseFrame(Connection &connection, Frame *frame);
+	static void freeBuffer(Connection &connection, Frame &frame);
+	void releaseIdleBuffers();
+	void dispatchFrame(Connection &connection, Frame *frame);
+	void dispatchBundle(Connection &connection, Frame *frame);
+	static bool getBundlePart(Frame &bundleFrame, BundlePart bundlePart, Frame &part);
+	static ros::Time getFrameStamp(const Frame &frame); // Simulator time
+
+	void sendReply(Connection &connection, const std::string &reply);
+	void sendTimeSyncReply(Connection &connection, const ros::Time &t1, const ros::Time &t2);
+	void formatReplies(Connection &connection);
+	void flushOutput(Connection &connection);
+	void updateEvents(Connection &connection);
+	void wakeReactor();
+
+	void closeConnection(boost::shared_ptr<Connection> connection); // By value since it may be the entry erased from connections
+	void finishClosedConnections(bool waitForAll);
+
+	void initDecodeWorker(int workerIndex);
+	void initEncodeWorker(int workerIndex);
+
+	void processLane(Connection *connection, Lane *lane);
+	void dispatchToStrand(Connection &connection, Frame *frame);
+	TopicStrand &getStrand(Connection &connection, const std::string &topic);
+	void scheduleFrame(Connection &connection, TopicStrand &strand, Frame *frame);
+	void processStrand(TopicStrand *strand);
+	void publish(const PublishItem &publishItem);
+
+	TopicInfo *getTopicInfo(std::map<std::string, TopicInfo> &topicInfoMap, const std::string &topicValue, const std::string &typeValue); // Advertises a new topic
 
-	static bool isRunning;
-	static int  syncTimeCnt;
-	static int  syncTimeMaxNum;
+	void processBundleParts(Connection &connection, std::map<std::string, TopicInfo> &topicInfoMap, Frame &frame);
+	void processSensorBundle(TopicInfo &bundleInfo, const Frame &frame, const ClockConversion &clockConversion);
+	void decodeImage(TopicInfo &topicInfo, const bsoncxx::document::view &msgView, const ClockConversion &clockConversion, sensor_msgs::Image &image);
+	void decodeCameraInfo(TopicInfo &topicInfo, const bsoncxx::document::view &msgView, const ClockConversion &clockConversion, sensor_msgs::CameraInfo &cameraInfo);
+	bool getCameraModel(const std::string &cameraInfoTopic, CameraModel &cameraModel);
+	void publishImageOutputs(TopicInfo &topicInfo, const std::string &topicValue, const sensor_msgs::ImagePtr &image); // Derived from a decoded image
+	void publishPyramid   (TopicInfo &topicInfo, const std::string &topicValue, const sensor_msgs::Image &image);
+	void publishCompressed(TopicInfo &topicInfo, const sensor_msgs::ImagePtr &image);
+	static void encodeImage(const boost::shared_ptr<CompressedOutput> &compressedOutput, const sensor_msgs::ImageConstPtr &image); // In the encode pool
+	void publishDepthCloud(TopicInfo &topicInfo, const std::string &topicValue, const sensor_msgs::Image &depth);
+	void publishDepthScan (TopicInfo &topicInfo, const std::string &topicValue, const sensor_msgs::Image &depth);
+	void publishScanCloud (TopicInfo &topicInfo, const sensor_msgs::LaserScan &scan);
+
+	bool isWithinDeadband(TfFrameState &frameState, const geometry_msgs::TransformStamped &transformStamped);
+	bool isStaticTransform(TfFrameState &frameState, const geometry_msgs::TransformStamped &transformStamped,
+	                       std::vector<geometry_msgs::TransformStamped> &promotedTransforms, std::vector<std::string> &demotedFrameIds);
+	void publishStaticTransforms(const std::vector<geometry_msgs::TransformStamped> &promotedTransforms, const std::vector<std::string> &demotedFrameIds);
+
+	FrameResult processFrame(Connection &connection, std::map<std::string, TopicInfo> &topicInfoMap, Frame &frame, PublishItem &publishItem);
+	bool shouldDrop(TopicInfo &topicInfo, const Frame &frame, const ClockConversion &clockConversion);
+	void publishClock(const ros::Time &clock);
+	void publishClockQuality(Connection &connection);
+	void reportDrops(std::map<std::string, TopicInfo> &topicInfoMap);
+
+	ros::NodeHandle nodeHandle;
+
+	boost::mutex                    imageTransportMutex; // Plugins are loaded while advertising, which is not thread-safe
+	image_transport::ImageTransport imageTransport;
+
+	TopicPolicyTable topicPolicyTable;
+
+	std::string tfPrefix; // Prepended to the frame ids of TF lists
+
+	bool publishBundles; // Publish sensor bundles also as sigverse_ros_bridge/SensorBundle
+
+	bool correctStamps; // Convert header and TF stamps from the simulator clock into ROS time
+
+	int tfStaticFrameNum; // A transform identical in this many TF lists is moved to /tf_static. 0 disables it.
+
+	TfDeadbandTable tfDeadbandTable;
+
+	SensorOutputTable sensorOutputTable;
+
+	// Intrinsics of the camera info topics used by the depth outputs, shared by all strands
+	boost::mutex                       cameraModelMutex;
+	std::map<std::string, CameraModel> cameraModels; // Keyed by resolved camera info topic
+
+	ros::Publisher diagnosticsPublisher;
+
+	// Simulator time on /clock, shared by all connections to keep it monotonic
+	boost::mutex   clockMutex;
+	ros::Publisher clockPublisher;
+	ros::Time      lastClock;
+	double         clockResetThreshold; // [s] The clock going back further than this is a restart of the simulation
+	uint64_t       clockDropNum;
+
+	// Shared by all connections, since /tf_static latches one message with every static transform
+	boost::mutex   staticTransformMutex;
+	ros::Publisher staticTransformPublisher;
+	std::map<std::string, geometry_msgs::TransformStamped> staticTransforms; // Keyed by child frame id
+
+	bool usePriorityLanes;
+	int  decodeWorkerNum;
+	bool reportLatency; // Print the latency percentiles of the lanes and strands every STATS_REPORT_INTERVAL
+
+	ThreadTuning listenerTuning;
+	ThreadTuning controlTuning;
+	ThreadTuning decodeTuning;
+	ThreadTuning encodeTuning;
+
+	std::atomic<bool> lockBuffers; // mlock the frame buffers
+	size_t frameBufferLimit;       // [byte] Buffer capacity a connection keeps between frames
+
+	// Shared by all connections
+	boost::shared_ptr<WorkStealingPool> decodePool;
+
+	// Compresses images for the image_transport plugins off the decode pool
+	boost::shared_ptr<EncodePool> encodePool;
+	int encodeWorkerNum;
+	int encodeQueueSize;
+
+	uint16_t portNumber;
+
+	std::atomic<bool> isRunning;
+	std::atomic<int> syncTimeCnt; // Legacy time gap replies sent
+	int  syncTimeMaxNum;
+
+	// Reactor state. Touched only by the thread in run() except for wakeFd.
+	int epollFd;
+	int wakeFd; // eventfd to wake the reactor from the lanes and the strands
+
+	std::map<int, boost::shared_ptr<Connection> > connections; // Keyed by socket
+	std::vector<boost::shared_ptr<Connection> > closedConnections; // Waiting for their frames to be processed
 
 public:
-	int run(int argc, char **argv);
+	SIGVerseROSBridge(const ros::NodeHandle &nodeHandle, const ros::NodeHandle &privateNodeHandle, uint16_t portNumber, int syncTimeMaxNum);
+
+	int  run();
+	void stop();
 };
 
 #endif // SIGVERSE_ROS_BRIDGE_HPP
@@ -0,0 +1,30 @@
+#include <unistd.h>
+#include <cstdlib>
+#include <iostream>
+
+#include <ros/ros.h>
+#include <nodelet/loader.h>
+
+int main(int argc, char **argv)
+{
+	std::cout << "pid=" << getpid() << std::endl;
+
+	ros::init(argc, argv, "sigverse_ros_bridge");
+
+	// Run the bridge nodelet in this process. ros::init has already removed the ROS remapping arguments,
+	// so the remaining ones are the port number and the sync time max num.
+	nodelet::Loader nodeletLoader(false);
+
+	nodelet::M_string remappings(ros::names::getRemappings());
+	nodelet::V_string nodeletArgv(argv + 1, argv + argc);
+
+	if(!nodeletLoader.load(ros::this_node::getName(), "sigverse_ros_bridge/BridgeNodelet", remappings, nodeletArgv))
+	{
+		std::cout << "Failed to load sigverse_ros_bridge/BridgeNodelet" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	ros::spin();
+
+	return 0;
+}
@@ -0,0 +1,74 @@
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/thread.hpp>
+
+#include "sigverse_ros_bridge.hpp"
+
+namespace sigverse_ros_bridge
+{
+
+class BridgeNodelet : public nodelet::Nodelet
+{
+private:
+	virtual void onInit();
+
+	void listeningThread();
+
+	boost::shared_ptr<SIGVerseROSBridge> bridge;
+	boost::shared_ptr<boost::thread>     listener;
+
+public:
+	virtual ~BridgeNodelet();
+};
+
+
+void BridgeNodelet::onInit()
+{
+	ros::NodeHandle &privateNodeHandle = getPrivateNodeHandle();
+
+	int portNumber     = DEFAULT_PORT;
+	int syncTimeMaxNum = DEFAULT_SYNC_TIME_MAX_NUM;
+
+	// Positional arguments are kept for compatibility with "rosrun sigverse_ros_bridge sigverse_ros_bridge <port> <sync_time_max_num>"
+	const std::vector<std::string> &myArgv = getMyArgv();
+
+	if(myArgv.size() > 0)
+	{
+		portNumber = std::atoi(myArgv[0].c_str());
+	}
+
+	if(myArgv.size() > 1)
+	{
+		syncTimeMaxNum = std::atoi(myArgv[1].c_str());
+	}
+
+	privateNodeHandle.param("port",              portNumber,     portNumber);
+	privateNodeHandle.param("sync_time_max_num", syncTimeMaxNum, syncTimeMaxNum);
+
+	bridge.reset(new SIGVerseROSBridge(getNodeHandle(), privateNodeHandle, (uint16_t)portNumber, syncTimeMaxNum));
+
+	// onInit must not block the nodelet manager
+	listener.reset(new boost::thread(boost::bind(&BridgeNodelet::listeningThread, this)));
+}
+
+void BridgeNodelet::listeningThread()
+{
+	bridge->run();
+}
+
+BridgeNodelet::~BridgeNodelet()
+{
+	if(bridge)
+	{
+		bridge->stop();
+	}
+
+	if(listener)
+	{
+		listener->join();
+	}
+}
+
+} // namespace sigverse_ros_bridge
+
+PLUGINLIB_EXPORT_CLASS(sigverse_ros_bridge::BridgeNodelet, nodelet::Nodelet)
@@ -0,0 +1,147 @@
+#ifndef SIGVERSE_SPSC_RING_HPP
+#define SIGVERSE_SPSC_RING_HPP
+
+#include <unistd.h>
+#include <atomic>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#define SPSC_RING_SPIN_NUM 1000
+
+/**
+ * Lock-free ring buffer between one producer thread and one consumer thread.
+ *
+ * Pushing and popping do not lock. Only a consumer which finds the ring empty for a while goes to sleep,
+ * and only then does the producer take the mutex to wake it up.
+ */
+template < class ItemType >
+class SpscRing
+{
+private:
+	std::vector<ItemType> items;
+	size_t mask;
+
+	// Written by the consumer and the producer respectively. Kept on separate cache lines.
+	char headPadding[64];
+	std::atomic<size_t> head;
+	char tailPadding[64];
+	std::atomic<size_t> tail;
+	char flagPadding[64];
+
+	std::atomic<bool> isConsumerWaiting;
+	std::atomic<bool> isClosed;
+
+	boost::mutex mutex;
+	boost::condition_variable condition;
+
+	void wakeConsumer()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if(isConsumerWaiting.load(std::memory_order_relaxed))
+		{
+			boost::mutex::scoped_lock lock(mutex);
+			condition.notify_one();
+		}
+	}
+
+public:
+	// The capacity is rounded up to a power of two
+	explicit SpscRing(size_t capacity) : head(0), tail(0), isConsumerWaiting(false), isClosed(false)
+	{
+		size_t size = 1;
+
+		while(size < capacity){ size <<= 1; }
+
+		items.resize(size);
+		mask = size - 1;
+	}
+
+	bool tryPush(ItemType &item)
+	{
+		size_t currentTail = tail.load(std::memory_order_relaxed);
+
+		if(currentTail - head.load(std::memory_order_acquire) > mask){ return false; }
+
+		// Hand over the ownership of the item
+		std::swap(items[currentTail & mask], item);
+
+		tail.store(currentTail + 1, std::memory_order_release);
+
+		wakeConsumer();
+
+		return true;
+	}
+
+	// Waits while the ring is full. Returns false when the ring is closed.
+	bool push(ItemType &item)
+	{
+		while(!tryPush(item))
+		{
+			if(isClosed.load(std::memory_order_acquire)){ return false; }
+
+			usleep(100);
+		}
+
+		return true;
+	}
+
+	bool tryPop(ItemType &item)
+	{
+		size_t currentHead = head.load(std::memory_order_relaxed);
+
+		if(currentHead == tail.load(std::memory_order_acquire)){ return false; }
+
+		std::swap(item, items[currentHead & mask]);
+		items[currentHead & mask] = ItemType();
+
+		head.store(currentHead + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	// Waits for an item. Returns false when the ring is closed and empty.
+	bool pop(ItemType &item)
+	{
+		for(int i=0; i<SPSC_RING_SPIN_NUM; i++)
+		{
+			if(tryPop(item)){ return true; }
+		}
+
+		boost::mutex::scoped_lock lock(mutex);
+
+		while(true)
+		{
+			isConsumerWaiting.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			if(tryPop(item)) { break; }
+
+			if(isClosed.load(std::memory_order_acquire))
+			{
+				// An item may have been pushed just before closing
+				if(tryPop(item)){ break; }
+
+				isConsumerWaiting.store(false, std::memory_order_relaxed);
+				return false;
+			}
+
+			condition.wait(lock);
+		}
+
+		isConsumerWaiting.store(false, std::memory_order_relaxed);
+		return true;
+	}
+
+	void close()
+	{
+		isClosed.store(true, std::memory_order_release);
+
+		boost::mutex::scoped_lock lock(mutex);
+		condition.notify_all();
+	}
+};
+
+#endif // SIGVERSE_SPSC_RING_HPP
@@ -0,0 +1,107 @@
+#include "thread_tuning.hpp"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+void ThreadTuning::load(const ros::NodeHandle &privateNodeHandle, const std::string &threadKind)
+{
+	std::string cpuList;
+
+	privateNodeHandle.param(threadKind + "_cpus",          cpuList,      std::string());
+	privateNodeHandle.param(threadKind + "_fifo_priority", fifoPriority, 0);
+
+	if(!parseCpuList(cpuList, cpus))
+	{
+		std::cout << threadKind << "_cpus is invalid. Ignored. value=" << cpuList << std::endl;
+		cpus.clear();
+	}
+
+	if(fifoPriority < 0 || fifoPriority > 99)
+	{
+		std::cout << threadKind << "_fifo_priority must be 0-99. Ignored. value=" << fifoPriority << std::endl;
+		fifoPriority = 0;
+	}
+}
+
+void ThreadTuning::apply(const std::string &threadName) const
+{
+	if(!cpus.empty())
+	{
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+
+		for(size_t i=0; i<cpus.size(); i++)
+		{
+			CPU_SET(cpus[i], &cpuSet);
+		}
+
+		int error = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+
+		if(error != 0)
+		{
+			std::cout << "Can not set CPU affinity. thread=" << threadName << " error=" << strerror(error) << std::endl;
+		}
+	}
+
+	if(fifoPriority > 0)
+	{
+		struct sched_param schedParam;
+		schedParam.sched_priority = fifoPriority;
+
+		int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedParam);
+
+		if(error != 0)
+		{
+			std::cout << "Can not use SCHED_FIFO. thread=" << threadName << " error=" << strerror(error) << std::endl;
+		}
+	}
+}
+
+bool ThreadTuning::parseCpuList(const std::string &cpuList, std::vector<int> &cpus)
+{
+	cpus.clear();
+
+	std::stringstream cpuListStream(cpuList);
+	std::string range;
+
+	while(std::getline(cpuListStream, range, ','))
+	{
+		if(range.empty()){ continue; }
+
+		char *end;
+
+		long first = strtol(range.c_str(), &end, 10);
+		long last  = first;
+
+		if(*end == '-')
+		{
+			last = strtol(end + 1, &end, 10);
+		}
+
+		if(*end != '\0' || first < 0 || last < first || last >= CPU_SETSIZE){ return false; }
+
+		for(long cpu=first; cpu<=last; cpu++)
+		{
+			cpus.push_back((int)cpu);
+		}
+	}
+
+	return true;
+}
+
+bool ThreadTuning::lockMemory(const void *address, size_t size)
+{
+	if(mlock(address, size) != 0)
+	{
+		std::cout << "Can not lock buffer in memory. size=" << size << " error=" << strerror(errno) << std::endl;
+		return false;
+	}
+
+	return true;
+}
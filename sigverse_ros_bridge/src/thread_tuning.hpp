@@ -0,0 +1,35 @@
+#ifndef SIGVERSE_THREAD_TUNING_HPP
+#define SIGVERSE_THREAD_TUNING_HPP
+
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+
+/**
+ * CPU placement and scheduling of a kind of thread, e.g.
+ *
+ *   control_cpus: "2-3"
+ *   control_fifo_priority: 50
+ *
+ * CPU lists are in the format of taskset, e.g. "0,2,4-7". An empty list leaves the thread to the OS scheduler.
+ */
+struct ThreadTuning
+{
+	std::vector<int> cpus;
+	int fifoPriority; // SCHED_FIFO priority (1-99). 0 means the normal scheduler.
+
+	ThreadTuning() : fifoPriority(0) {}
+
+	void load(const ros::NodeHandle &privateNodeHandle, const std::string &threadKind);
+
+	// Applied to the calling thread. Failures (e.g. no CAP_SYS_NICE) are reported and ignored.
+	void apply(const std::string &threadName) const;
+
+	static bool parseCpuList(const std::string &cpuList, std::vector<int> &cpus);
+
+	// Keeps the pages of a buffer in RAM. Returns false if the lock limit (ulimit -l) is exceeded.
+	static bool lockMemory(const void *address, size_t size);
+};
+
+#endif // SIGVERSE_THREAD_TUNING_HPP
@@ -0,0 +1,143 @@
+#include "topic_policy.hpp"
+
+#include <fnmatch.h>
+#include <iostream>
+
+#include "param_member.hpp"
+
+
+uint32_t TopicPolicy::getQueueSize(uint32_t defaultQueueSize) const
+{
+	if(keepLatest){ return 1; }
+
+	if(queueSize < 0){ return defaultQueueSize; }
+
+	return (uint32_t)queueSize;
+}
+
+
+void TopicPolicyTable::load(const ros::NodeHandle &privateNodeHandle)
+{
+	entries.clear();
+
+	XmlRpc::XmlRpcValue policyList;
+
+	if(!privateNodeHandle.getParam("topic_policies", policyList)){ return; }
+
+	if(policyList.getType() != XmlRpc::XmlRpcValue::TypeArray)
+	{
+		std::cout << "topic_policies must be a list. Ignored." << std::endl;
+		return;
+	}
+
+	for(int i=0; i<policyList.size(); i++)
+	{
+		XmlRpc::XmlRpcValue &policyValue = policyList[i];
+
+		if(policyValue.getType() != XmlRpc::XmlRpcValue::TypeStruct || !policyValue.hasMember("topic"))
+		{
+			std::cout << "topic_policies[" << i << "] has no topic. Ignored." << std::endl;
+			continue;
+		}
+
+		Entry entry;
+
+		bool isValid =
+			readParamMember(policyValue, "topic",       entry.pattern)           &&
+			readParamMember(policyValue, "queue_size",  entry.policy.queueSize)  &&
+			readParamMember(policyValue, "latch",       entry.policy.latch)      &&
+			readParamMember(policyValue, "keep_latest", entry.policy.keepLatest) &&
+			readParamMember(policyValue, "max_rate",    entry.policy.maxRate)    &&
+			readParamMember(policyValue, "max_age",     entry.policy.maxAge)     &&
+			readParamMember(policyValue, "flip_vertical",   entry.policy.imageTransform.flipVertical) &&
+			readParamMember(policyValue, "encoding",        entry.policy.imageTransform.encoding)     &&
+			readParamMember(policyValue, "pyramid_levels",  entry.policy.pyramidLevelNum)             &&
+			readParamMember(policyValue, "image_transport", entry.policy.useImageTransport);
+
+		if(!isValid)
+		{
+			std::cout << "topic_policies[" << i << "] has a value of a wrong type. Ignored." << std::endl;
+			continue;
+		}
+
+		std::cout << "Topic policy " << entry.pattern << " queue_size=" << entry.policy.queueSize
+		          << " latch=" << entry.policy.latch << " keep_latest=" << entry.policy.keepLatest
+		          << " max_rate=" << entry.policy.maxRate << " max_age=" << entry.policy.maxAge
+		          << " flip_vertical=" << entry.policy.imageTransform.flipVertical << " encoding=" << entry.policy.imageTransform.encoding
+		          << " pyramid_levels=" << entry.policy.pyramidLevelNum << " image_transport=" << entry.policy.useImageTransport << std::endl;
+
+		entries.push_back(entry);
+	}
+}
+
+TopicPolicy TopicPolicyTable::get(const std::string &resolvedTopic) const
+{
+	for(size_t i=0; i<entries.size(); i++)
+	{
+		if(fnmatch(entries[i].pattern.c_str(), resolvedTopic.c_str(), 0) == 0)
+		{
+			return entries[i].policy;
+		}
+	}
+
+	return TopicPolicy();
+}
+
+
+void TfDeadbandTable::load(const ros::NodeHandle &privateNodeHandle)
+{
+	entries.clear();
+
+	XmlRpc::XmlRpcValue deadbandList;
+
+	if(!privateNodeHandle.getParam("tf_deadbands", deadbandList)){ return; }
+
+	if(deadbandList.getType() != XmlRpc::XmlRpcValue::TypeArray)
+	{
+		std::cout << "tf_deadbands must be a list. Ignored." << std::endl;
+		return;
+	}
+
+	for(int i=0; i<deadbandList.size(); i++)
+	{
+		XmlRpc::XmlRpcValue &deadbandValue = deadbandList[i];
+
+		if(deadbandValue.getType() != XmlRpc::XmlRpcValue::TypeStruct || !deadbandValue.hasMember("frame"))
+		{
+			std::cout << "tf_deadbands[" << i << "] has no frame. Ignored." << std::endl;
+			continue;
+		}
+
+		Entry entry;
+
+		bool isValid =
+			readParamMember(deadbandValue, "frame",        entry.pattern)              &&
+			readParamMember(deadbandValue, "translation",  entry.deadband.translation) &&
+			readParamMember(deadbandValue, "rotation",     entry.deadband.rotation)    &&
+			readParamMember(deadbandValue, "max_interval", entry.deadband.maxInterval);
+
+		if(!isValid)
+		{
+			std::cout << "tf_deadbands[" << i << "] has a value of a wrong type. Ignored." << std::endl;
+			continue;
+		}
+
+		std::cout << "TF deadband " << entry.pattern << " translation=" << entry.deadband.translation
+		          << " rotation=" << entry.deadband.rotation << " max_interval=" << entry.deadband.maxInterval << std::endl;
+
+		entries.push_back(entry);
+	}
+}
+
+const TfDeadband *TfDeadbandTable::get(const std::string &childFrameId) const
+{
+	for(size_t i=0; i<entries.size(); i++)
+	{
+		if(fnmatch(entries[i].pattern.c_str(), childFrameId.c_str(), 0) == 0)
+		{
+			return &entries[i].deadband;
+		}
+	}
+
+	return NULL;
+}
@@ -0,0 +1,110 @@
+#ifndef SIGVERSE_TOPIC_POLICY_HPP
+#define SIGVERSE_TOPIC_POLICY_HPP
+
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+
+#include "image_transform.hpp"
+
+/**
+ * Publisher settings of a topic.
+ */
+struct TopicPolicy
+{
+	int  queueSize;  // Publisher queue size. A negative value means the default of the message type.
+	bool latch;
+	bool keepLatest; // Keep only the latest message for each subscriber (queue size 1),
+	                 // and drop a received frame before decoding when a newer frame of the topic is already waiting.
+	double maxRate;  // [Hz]  Frames above this rate are dropped before decoding. 0 means no limit.
+	double maxAge;   // [sec] Frames whose header stamp is older than this are dropped before decoding. 0 means no limit.
+
+	ImageTransform imageTransform; // Images only. Applied while the pixels are copied out of the frame.
+	int pyramidLevelNum;           // Images only. Downscaled outputs on <topic>/half and <topic>/quarter (0 to 2).
+	bool useImageTransport;        // Images only. Also published through the image_transport plugins, e.g. <topic>/compressed.
+
+	TopicPolicy() : queueSize(-1), latch(false), keepLatest(false), maxRate(0.0), maxAge(0.0), pyramidLevelNum(0), useImageTransport(false) {}
+
+	uint32_t getQueueSize(uint32_t defaultQueueSize) const;
+};
+
+/**
+ * Topic policies keyed by topic glob, e.g.
+ *
+ *   topic_policies:
+ *     - topic: "*image_raw"
+ *       queue_size: 1
+ *       latch: false
+ *       keep_latest: true
+ *       max_rate: 10.0
+ *       max_age: 0.5
+ *       flip_vertical: true
+ *       encoding: "bgr8"
+ *       pyramid_levels: 2
+ *       image_transport: true
+ *
+ * The first entry whose pattern matches the resolved topic name is used.
+ */
+class TopicPolicyTable
+{
+private:
+	struct Entry
+	{
+		std::string pattern;
+		TopicPolicy policy;
+	};
+
+	std::vector<Entry> entries;
+
+public:
+	void load(const ros::NodeHandle &privateNodeHandle);
+
+	TopicPolicy get(const std::string &resolvedTopic) const;
+};
+
+/**
+ * Change thresholds of a TF frame. A transform that has moved less than both thresholds since it was last published
+ * is not published again until the maximum interval has passed.
+ */
+struct TfDeadband
+{
+	double translation; // [m]
+	double rotation;    // [rad]
+	double maxInterval; // [sec] 0 means no republishing of an unchanged transform.
+
+	TfDeadband() : translation(0.0), rotation(0.0), maxInterval(0.0) {}
+};
+
+/**
+ * TF deadbands keyed by child frame glob, e.g.
+ *
+ *   tf_deadbands:
+ *     - frame: "*_link"
+ *       translation: 0.0005
+ *       rotation: 0.001
+ *       max_interval: 1.0
+ *
+ * The first entry whose pattern matches the (prefixed) child frame id is used.
+ */
+class TfDeadbandTable
+{
+private:
+	struct Entry
+	{
+		std::string pattern;
+		TfDeadband  deadband;
+	};
+
+	std::vector<Entry> entries;
+
+public:
+	void load(const ros::NodeHandle &privateNodeHandle);
+
+	// NULL if no entry matches. The pointer is valid until the next load().
+	const TfDeadband *get(const std::string &childFrameId) const;
+
+	bool empty() const { return entries.empty(); }
+};
+
+#endif // SIGVERSE_TOPIC_POLICY_HPP
@@ -0,0 +1,130 @@
+#include "work_stealing_pool.hpp"
+
+// The pool and the worker index of the current thread, if it is a worker
+static thread_local WorkStealingPool *currentPool        = NULL;
+static thread_local int               currentWorkerIndex = -1;
+
+WorkStealingPool::WorkStealingPool(int workerNum, const boost::function<void (int)> &workerInitializer)
+	: pendingTaskNum(0), nextWorkerIndex(0), isRunning(true), workerInitializer(workerInitializer)
+{
+	if(workerNum < 1){ workerNum = 1; }
+
+	for(int i=0; i<workerNum; i++)
+	{
+		workers.push_back(boost::shared_ptr<Worker>(new Worker()));
+	}
+
+	for(int i=0; i<workerNum; i++)
+	{
+		workers[i]->thread.reset(new boost::thread(boost::bind(&WorkStealingPool::work, this, i)));
+	}
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		boost::mutex::scoped_lock lock(sleepMutex);
+		isRunning = false;
+	}
+
+	sleepCondition.notify_all();
+
+	for(size_t i=0; i<workers.size(); i++)
+	{
+		workers[i]->thread->join();
+	}
+}
+
+void WorkStealingPool::submit(WorkStealingTask *task)
+{
+	int workerIndex;
+
+	if(currentPool == this)
+	{
+		workerIndex = currentWorkerIndex;
+	}
+	else
+	{
+		workerIndex = (int)(nextWorkerIndex++ % workers.size());
+	}
+
+	{
+		boost::mutex::scoped_lock lock(workers[workerIndex]->mutex);
+		workers[workerIndex]->tasks.push_back(task);
+	}
+
+	pendingTaskNum++;
+
+	{
+		boost::mutex::scoped_lock lock(sleepMutex);
+	}
+
+	sleepCondition.notify_one();
+}
+
+bool WorkStealingPool::take(int workerIndex, WorkStealingTask *&task)
+{
+	// Own queue first
+	{
+		Worker &worker = *workers[workerIndex];
+
+		boost::mutex::scoped_lock lock(worker.mutex);
+
+		if(!worker.tasks.empty())
+		{
+			task = worker.tasks.front();
+			worker.tasks.pop_front();
+			return true;
+		}
+	}
+
+	// Steal from the others
+	for(size_t i=1; i<workers.size(); i++)
+	{
+		Worker &victim = *workers[(workerIndex + i) % workers.size()];
+
+		boost::mutex::scoped_try_lock lock(victim.mutex);
+
+		if(lock.owns_lock() && !victim.tasks.empty())
+		{
+			task = victim.tasks.back();
+			victim.tasks.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void WorkStealingPool::work(int workerIndex)
+{
+	currentPool        = this;
+	currentWorkerIndex = workerIndex;
+
+	if(workerInitializer){ workerInitializer(workerIndex); }
+
+	while(true)
+	{
+		WorkStealingTask *task;
+
+		if(take(workerIndex, task))
+		{
+			pendingTaskNum--;
+
+			task->run();
+			continue;
+		}
+
+		boost::mutex::scoped_lock lock(sleepMutex);
+
+		if(pendingTaskNum > 0)
+		{
+			// A task exists but its queue was locked by another worker
+			continue;
+		}
+
+		if(!isRunning){ break; }
+
+		sleepCondition.wait(lock);
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef SIGVERSE_WORK_STEALING_POOL_HPP
+#define SIGVERSE_WORK_STEALING_POOL_HPP
+
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+class WorkStealingTask
+{
+public:
+	virtual ~WorkStealingTask() {}
+
+	virtual void run() = 0;
+};
+
+/**
+ * Thread pool in which every worker has its own task queue.
+ *
+ * A worker takes the oldest task of its own queue. When its queue is empty, it steals the newest task of another
+ * worker's queue, so busy queues are shared out among idle workers. Tasks submitted from outside of the pool are
+ * distributed round-robin, and tasks submitted by a worker go to its own queue.
+ *
+ * The pool does not own the tasks.
+ */
+class WorkStealingPool
+{
+private:
+	struct Worker
+	{
+		boost::mutex mutex;
+		std::deque<WorkStealingTask *> tasks;
+
+		boost::shared_ptr<boost::thread> thread;
+	};
+
+	std::vector<boost::shared_ptr<Worker> > workers;
+
+	std::atomic<int>      pendingTaskNum;
+	std::atomic<unsigned> nextWorkerIndex;
+	std::atomic<bool>     isRunning;
+
+	boost::function<void (int)> workerInitializer;
+
+	boost::mutex              sleepMutex;
+	boost::condition_variable sleepCondition;
+
+	void work(int workerIndex);
+	bool take(int workerIndex, WorkStealingTask *&task);
+
+public:
+	// The initializer is called in each worker thread with its index before it runs any task
+	explicit WorkStealingPool(int workerNum, const boost::function<void (int)> &workerInitializer = boost::function<void (int)>());
+	~WorkStealingPool();
+
+	void submit(WorkStealingTask *task);
+
+	int getWorkerNum() const { return (int)workers.size(); }
+};
+
+#endif // SIGVERSE_WORK_STEALING_POOL_HPP
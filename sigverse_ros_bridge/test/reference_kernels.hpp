@@ -0,0 +1,255 @@
+#ifndef SIGVERSE_REFERENCE_KERNELS_HPP
+#define SIGVERSE_REFERENCE_KERNELS_HPP
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <string.h>
+#include <vector>
+
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/image_encodings.h>
+
+#include "depth_conversion.hpp"
+
+/**
+ * Plain scalar versions of the conversions, written from their definitions one pixel at a time.
+ * The tests check the vectorized kernels against them, and the benchmarks compare their speed with them.
+ */
+
+// A depth in meters. 16UC1 is in millimeters.
+inline float referenceDepth(const sensor_msgs::Image &depth, uint32_t u, uint32_t v)
+{
+	const uint8_t *row = &depth.data[(size_t)v * depth.step];
+
+	if(depth.encoding == sensor_msgs::image_encodings::TYPE_16UC1)
+	{
+		uint16_t millimeters;
+		memcpy(&millimeters, row + u * sizeof(uint16_t), sizeof(uint16_t));
+		return (float)millimeters * 0.001f;
+	}
+
+	float meters;
+	memcpy(&meters, row + u * sizeof(float), sizeof(float));
+	return meters;
+}
+
+// x, y and z of every pixel as depth_image_proc/point_cloud_xyz computes them
+inline void referenceDepthCloud(const sensor_msgs::Image &depth, const CameraModel &cameraModel, std::vector<float> &points)
+{
+	const float badPoint = std::numeric_limits<float>::quiet_NaN();
+
+	const float centerX   = (float)cameraModel.cx;
+	const float centerY   = (float)cameraModel.cy;
+	const float constantX = (float)(1.0 / cameraModel.fx);
+	const float constantY = (float)(1.0 / cameraModel.fy);
+
+	points.resize((size_t)depth.width * depth.height * 3);
+
+	for(uint32_t v=0; v<depth.height; v++)
+	{
+		for(uint32_t u=0; u<depth.width; u++)
+		{
+			float *point = &points[((size_t)v * depth.width + u) * 3];
+
+			float z = referenceDepth(depth, u, v);
+
+			if(!(z > 0.0f))
+			{
+				point[0] = point[1] = point[2] = badPoint;
+				continue;
+			}
+
+			point[0] = ((float)u - centerX) * z * constantX;
+			point[1] = ((float)v - centerY) * z * constantY;
+			point[2] = z;
+		}
+	}
+}
+
+// Ranges as depthimage_to_laserscan computes them: per column, the nearest range within the limits among the scan rows
+inline void referenceDepthScan(const sensor_msgs::Image &depth, const CameraModel &cameraModel, const DepthScanSettings &settings, std::vector<float> &ranges)
+{
+	double angleMin       = -std::atan(((double)(depth.width-1) - cameraModel.cx) / cameraModel.fx);
+	double angleMax       = -std::atan((0.0                     - cameraModel.cx) / cameraModel.fx);
+	double angleIncrement = (angleMax - angleMin) / (double)(depth.width-1);
+
+	ranges.assign(depth.width, std::numeric_limits<float>::quiet_NaN());
+
+	int firstRow = (int)cameraModel.cy - settings.scanHeight/2;
+
+	for(int v=firstRow; v<firstRow+settings.scanHeight; v++)
+	{
+		for(uint32_t u=0; u<depth.width; u++)
+		{
+			double rayX = ((double)u - cameraModel.cx) / cameraModel.fx;
+
+			float range = referenceDepth(depth, u, (uint32_t)v) * (float)std::sqrt(1.0 + rayX * rayX);
+
+			// Zero and NaN fail as well
+			if(!(range >= settings.rangeMin && range <= settings.rangeMax)){ continue; }
+
+			float &bin = ranges[std::lround((-std::atan(rayX) - angleMin) / angleIncrement)];
+
+			if(std::isnan(bin) || range < bin){ bin = range; }
+		}
+	}
+}
+
+// x, y, z and intensity of the beams within the range limits, as laser_geometry::LaserProjection::projectLaser gives them
+inline void referenceScanCloud(const sensor_msgs::LaserScan &scan, std::vector<float> &points)
+{
+	bool hasIntensity = (scan.intensities.size() == scan.ranges.size());
+
+	points.clear();
+
+	for(size_t i=0; i<scan.ranges.size(); i++)
+	{
+		float range = scan.ranges[i];
+
+		if(!(range >= scan.range_min && range <= scan.range_max)){ continue; }
+
+		double angle = (double)scan.angle_min + (double)i * (double)scan.angle_increment;
+
+		points.push_back(range * (float)std::cos(angle));
+		points.push_back(range * (float)std::sin(angle));
+		points.push_back(0.0f);
+		points.push_back(hasIntensity ? scan.intensities[i] : 0.0f);
+	}
+}
+
+// Channels of an 8-bit color encoding in memory order, e.g. "bgra"
+inline std::string referenceChannelNames(const std::string &encoding)
+{
+	if(encoding == sensor_msgs::image_encodings::RGB8) { return "rgb"; }
+	if(encoding == sensor_msgs::image_encodings::BGR8) { return "bgr"; }
+	if(encoding == sensor_msgs::image_encodings::RGBA8){ return "rgba"; }
+	if(encoding == sensor_msgs::image_encodings::BGRA8){ return "bgra"; }
+
+	return "";
+}
+
+// Every channel of the output encoding taken by its name from the received pixel, and the rows flipped if requested
+inline void referenceConvertColor(const sensor_msgs::Image &src, const std::string &dstEncoding, bool flipVertical, std::vector<uint8_t> &dstData)
+{
+	std::string srcNames = referenceChannelNames(src.encoding);
+	std::string dstNames = referenceChannelNames(dstEncoding);
+
+	size_t srcChannelNum = srcNames.size();
+	size_t dstChannelNum = dstNames.size();
+
+	size_t srcChannels[4];
+
+	for(size_t c=0; c<dstChannelNum; c++){ srcChannels[c] = srcNames.find(dstNames[c]); }
+
+	dstData.resize((size_t)src.width * src.height * dstChannelNum);
+
+	for(uint32_t v=0; v<src.height; v++)
+	{
+		const uint8_t *srcRow = &src.data[(size_t)(flipVertical ? src.height-1-v : v) * src.step];
+		uint8_t       *dstRow = &dstData[(size_t)v * src.width * dstChannelNum];
+
+		for(uint32_t u=0; u<src.width; u++)
+		{
+			for(size_t c=0; c<dstChannelNum; c++)
+			{
+				dstRow[u * dstChannelNum + c] = srcRow[u * srcChannelNum + srcChannels[c]];
+			}
+		}
+	}
+}
+
+// A depth read byte by byte in the byte order of the image, in its own unit
+inline double referenceRawDepth(const sensor_msgs::Image &src, const uint8_t *pixel)
+{
+	bool isFloat = (src.encoding == sensor_msgs::image_encodings::TYPE_32FC1);
+
+	size_t   size = isFloat ? sizeof(float) : sizeof(uint16_t);
+	uint32_t bits = 0;
+
+	for(size_t i=0; i<size; i++)
+	{
+		size_t byteIndex = src.is_bigendian ? i : size-1-i; // Most significant first
+
+		bits = (bits << 8) | pixel[byteIndex];
+	}
+
+	if(!isFloat){ return (double)bits; }
+
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// Every depth converted between 32FC1 [m] and 16UC1 [mm] into the byte order of the host, and the rows flipped if requested.
+// NaN and 0 are the invalid depths, and a depth out of the range of 16UC1 becomes 0.
+inline void referenceConvertDepth(const sensor_msgs::Image &src, const std::string &dstEncoding, bool flipVertical, std::vector<uint8_t> &dstData)
+{
+	bool isSrcFloat = (src.encoding == sensor_msgs::image_encodings::TYPE_32FC1);
+	bool isDstFloat = (dstEncoding  == sensor_msgs::image_encodings::TYPE_32FC1);
+
+	size_t srcPixelSize = isSrcFloat ? sizeof(float) : sizeof(uint16_t);
+	size_t dstPixelSize = isDstFloat ? sizeof(float) : sizeof(uint16_t);
+
+	dstData.resize((size_t)src.width * src.height * dstPixelSize);
+
+	for(uint32_t v=0; v<src.height; v++)
+	{
+		const uint8_t *srcRow = &src.data[(size_t)(flipVertical ? src.height-1-v : v) * src.step];
+
+		for(uint32_t u=0; u<src.width; u++)
+		{
+			double depth = referenceRawDepth(src, srcRow + u * srcPixelSize);
+
+			uint8_t *dstPixel = &dstData[((size_t)v * src.width + u) * dstPixelSize];
+
+			if(isSrcFloat == isDstFloat)
+			{
+				if(isDstFloat){ float    value = (float)depth;    memcpy(dstPixel, &value, sizeof(value)); }
+				else          { uint16_t value = (uint16_t)depth; memcpy(dstPixel, &value, sizeof(value)); }
+			}
+			else if(isDstFloat)
+			{
+				float meters = (depth == 0.0) ? std::numeric_limits<float>::quiet_NaN() : (float)(depth / 1000.0);
+				memcpy(dstPixel, &meters, sizeof(meters));
+			}
+			else
+			{
+				float millimeters = (float)depth * 1000.0f;
+
+				uint16_t value = (millimeters >= 0.0f && millimeters <= 65535.0f) ? (uint16_t)std::nearbyint(millimeters) : 0;
+				memcpy(dstPixel, &value, sizeof(value));
+			}
+		}
+	}
+}
+
+// Every output pixel is the rounded mean of the two rows, then of the two columns, of a 2x2 block of 8-bit channels.
+// Odd last rows and columns are dropped.
+inline void referenceDownscale(const sensor_msgs::Image &src, int channelNum, std::vector<uint8_t> &dstData)
+{
+	uint32_t dstWidth  = src.width  / 2;
+	uint32_t dstHeight = src.height / 2;
+
+	dstData.resize((size_t)dstWidth * dstHeight * channelNum);
+
+	for(uint32_t v=0; v<dstHeight; v++)
+	{
+		for(uint32_t u=0; u<dstWidth; u++)
+		{
+			for(int c=0; c<channelNum; c++)
+			{
+				const uint8_t *upperLeft = &src.data[(size_t)(2*v) * src.step + (2*u) * channelNum + c];
+				const uint8_t *lowerLeft = upperLeft + src.step;
+
+				unsigned left  = (upperLeft[0]          + lowerLeft[0]          + 1) / 2;
+				unsigned right = (upperLeft[channelNum] + lowerLeft[channelNum] + 1) / 2;
+
+				dstData[((size_t)v * dstWidth + u) * channelNum + c] = (uint8_t)((left + right + 1) / 2);
+			}
+		}
+	}
+}
+
+#endif // SIGVERSE_REFERENCE_KERNELS_HPP
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include "clock_sync.hpp"
+
+// A simulator clock that started at simStart and runs faster than ROS time by drift
+static ros::Time toRos(double simTime, double rosStart, double drift)
+{
+	return ros::Time(rosStart + simTime * (1.0 + drift));
+}
+
+TEST(ClockSync, NoEstimateLeavesTime)
+{
+	ClockSync clockSync;
+
+	ros::Time time(100, 0);
+
+	EXPECT_FALSE(clockSync.getConversion().toRosTime(time));
+	EXPECT_EQ(ros::Time(100, 0), time);
+}
+
+TEST(ClockSync, ZeroStampIsNotConverted)
+{
+	ClockSync clockSync;
+	clockSync.addRoundTripSample(ros::Time(10.0), ros::Time(1000.0), ros::Time(1000.0), ros::Time(10.0));
+
+	ros::Time time;
+
+	EXPECT_FALSE(clockSync.getConversion().toRosTime(time));
+	EXPECT_TRUE(time.isZero());
+}
+
+TEST(ClockSync, RoundTripOffsetCancelsSymmetricDelay)
+{
+	ClockSync clockSync;
+
+	// Offset 1000 s, 5 ms each way, 1 ms in the bridge
+	clockSync.addRoundTripSample(ros::Time(10.000), ros::Time(1010.005), ros::Time(1010.006), ros::Time(10.011));
+
+	ClockQuality quality = clockSync.getQuality();
+
+	EXPECT_TRUE(quality.isRoundTrip);
+	EXPECT_NEAR(1000.0, quality.offset, 1.0e-6);
+	EXPECT_NEAR(0.010,  quality.delay,  1.0e-6);
+}
+
+// The simulator clock is far from ROS time and drifts. A converted stamp must still land on ROS time.
+TEST(ClockSync, DriftWithLargeOffset)
+{
+	const double rosStart = 1.7e9;  // [sec] ROS time when the simulator clock was 0
+	const double drift    = 50.0e-6;
+
+	ClockSync clockSync;
+
+	for(int i=0; i<CLOCK_SYNC_HISTORY_SIZE; i++)
+	{
+		double simTime = 100.0 + i;
+
+		ros::Time rosTime = toRos(simTime, rosStart, drift);
+
+		clockSync.addRoundTripSample(ros::Time(simTime), rosTime, rosTime, ros::Time(simTime));
+	}
+
+	EXPECT_NEAR(drift * 1.0e6, clockSync.getQuality().drift, 0.5);
+
+	ClockConversion conversion = clockSync.getConversion();
+
+	// Ahead of the last sample, so that the drift term matters
+	for(double simTime = 130.0; simTime <= 730.0; simTime += 100.0)
+	{
+		ros::Time time(simTime);
+
+		ASSERT_TRUE(conversion.toRosTime(time));
+		EXPECT_NEAR(toRos(simTime, rosStart, drift).toSec(), time.toSec(), 1.0e-4) << "simTime=" << simTime;
+	}
+}
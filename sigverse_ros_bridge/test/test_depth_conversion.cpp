@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "depth_conversion.hpp"
+#include "reference_kernels.hpp"
+#include "test_images.hpp"
+
+static void expectCloudMatchesReference(const std::string &encoding)
+{
+	CameraModel        cameraModel = makeCameraModel(testWidth, testHeight);
+	sensor_msgs::Image depth       = makeDepthImage(encoding, testWidth, testHeight, 1);
+
+	DepthCloudProjector projector;
+	projector.setCameraModel(cameraModel);
+
+	sensor_msgs::PointCloud2 cloud;
+
+	ASSERT_TRUE(projector.project(depth, cloud));
+
+	ASSERT_EQ(testWidth,  cloud.width);
+	ASSERT_EQ(testHeight, cloud.height);
+	ASSERT_EQ(16u,        cloud.point_step);
+	ASSERT_EQ((size_t)cloud.row_step * cloud.height, cloud.data.size());
+
+	std::vector<float> expectedPoints;
+	referenceDepthCloud(depth, cameraModel, expectedPoints);
+
+	for(uint32_t v=0; v<testHeight; v++)
+	{
+		for(uint32_t u=0; u<testWidth; u++)
+		{
+			const float *point    = (const float *)&cloud.data[(size_t)v * cloud.row_step + u * cloud.point_step];
+			const float *expected = &expectedPoints[((size_t)v * testWidth + u) * 3];
+
+			for(int i=0; i<3; i++)
+			{
+				if(std::isnan(expected[i]))
+				{
+					EXPECT_TRUE(std::isnan(point[i])) << "u=" << u << " v=" << v << " i=" << i;
+				}
+				else
+				{
+					EXPECT_NEAR(expected[i], point[i], 1.0e-5f * std::fabs(expected[2])) << "u=" << u << " v=" << v << " i=" << i;
+				}
+			}
+		}
+	}
+}
+
+TEST(CameraModel, TakesPOrElseK)
+{
+	sensor_msgs::CameraInfo cameraInfo;
+
+	cameraInfo.width  = testWidth;
+	cameraInfo.height = testHeight;
+
+	const double k[9]  = { 30.0, 0.0, 18.0,   0.0, 31.0, 3.0,   0.0, 0.0, 1.0 };
+	const double p[12] = { 29.0, 0.0, 17.5, 0.0,   0.0, 30.5, 2.5, 0.0,   0.0, 0.0, 1.0, 0.0 };
+
+	std::copy(k, k + 9, cameraInfo.K.begin());
+	std::fill(cameraInfo.P.begin(), cameraInfo.P.end(), 0.0);
+
+	// Uncalibrated: K
+	CameraModel fromK(cameraInfo);
+
+	EXPECT_EQ(30.0, fromK.fx);
+	EXPECT_EQ(31.0, fromK.fy);
+	EXPECT_EQ(18.0, fromK.cx);
+	EXPECT_EQ( 3.0, fromK.cy);
+
+	// Rectified: P, as depth_image_proc
+	std::copy(p, p + 12, cameraInfo.P.begin());
+
+	CameraModel fromP(cameraInfo);
+
+	EXPECT_EQ(29.0, fromP.fx);
+	EXPECT_EQ(30.5, fromP.fy);
+	EXPECT_EQ(17.5, fromP.cx);
+	EXPECT_EQ( 2.5, fromP.cy);
+	EXPECT_EQ(testWidth,  fromP.width);
+	EXPECT_EQ(testHeight, fromP.height);
+}
+
+TEST(DepthCloudProjector, FloatDepthMatchesReference)
+{
+	expectCloudMatchesReference(sensor_msgs::image_encodings::TYPE_32FC1);
+}
+
+TEST(DepthCloudProjector, ShortDepthMatchesReference)
+{
+	expectCloudMatchesReference(sensor_msgs::image_encodings::TYPE_16UC1);
+}
+
+TEST(DepthCloudProjector, RejectsOtherSizeAndEncoding)
+{
+	DepthCloudProjector projector;
+	projector.setCameraModel(makeCameraModel(testWidth, testHeight));
+
+	sensor_msgs::PointCloud2 cloud;
+
+	sensor_msgs::Image depth = makeDepthImage(sensor_msgs::image_encodings::TYPE_32FC1, testWidth + 1, testHeight, 2);
+	EXPECT_FALSE(projector.project(depth, cloud));
+
+	depth = makeDepthImage(sensor_msgs::image_encodings::TYPE_32FC1, testWidth, testHeight, 2);
+	depth.encoding = sensor_msgs::image_encodings::RGB8;
+	EXPECT_FALSE(projector.project(depth, cloud));
+}
+
+static void expectScanMatchesReference(const std::string &encoding)
+{
+	CameraModel        cameraModel = makeCameraModel(testWidth, testHeight);
+	sensor_msgs::Image depth       = makeDepthImage(encoding, testWidth, testHeight, 3);
+
+	DepthScanSettings settings;
+	settings.scanHeight = 3;
+
+	DepthScanConverter converter;
+	converter.setCameraModel(cameraModel, settings);
+
+	sensor_msgs::LaserScan scan;
+
+	ASSERT_TRUE(converter.convert(depth, scan));
+
+	std::vector<float> expectedRanges;
+	referenceDepthScan(depth, cameraModel, settings, expectedRanges);
+
+	ASSERT_EQ(expectedRanges.size(), scan.ranges.size());
+
+	EXPECT_NEAR(-std::atan((testWidth-1 - cameraModel.cx) / cameraModel.fx), scan.angle_min, 1.0e-6);
+	EXPECT_NEAR(-std::atan((0.0         - cameraModel.cx) / cameraModel.fx), scan.angle_max, 1.0e-6);
+
+	int validNum = 0;
+
+	for(size_t i=0; i<expectedRanges.size(); i++)
+	{
+		if(std::isnan(expectedRanges[i]))
+		{
+			EXPECT_TRUE(std::isnan(scan.ranges[i])) << "i=" << i;
+		}
+		else
+		{
+			EXPECT_NEAR(expectedRanges[i], scan.ranges[i], 1.0e-5f * expectedRanges[i]) << "i=" << i;
+			validNum++;
+		}
+	}
+
+	// The depths are mostly in the range
+	EXPECT_GT(validNum, testWidth / 2);
+}
+
+TEST(DepthScanConverter, FloatDepthMatchesReference)
+{
+	expectScanMatchesReference(sensor_msgs::image_encodings::TYPE_32FC1);
+}
+
+TEST(DepthScanConverter, ShortDepthMatchesReference)
+{
+	expectScanMatchesReference(sensor_msgs::image_encodings::TYPE_16UC1);
+}
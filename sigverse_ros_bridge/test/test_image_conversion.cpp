@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "image_conversion.hpp"
+#include "reference_kernels.hpp"
+#include "test_images.hpp"
+
+static const char *const colorEncodings[] =
+{
+	sensor_msgs::image_encodings::RGB8.c_str(),
+	sensor_msgs::image_encodings::BGR8.c_str(),
+	sensor_msgs::image_encodings::RGBA8.c_str(),
+	sensor_msgs::image_encodings::BGRA8.c_str(),
+};
+
+// Random pixels in rows padded at the end, as received
+static sensor_msgs::Image makeColorImage(const std::string &encoding, unsigned seed)
+{
+	return makeRandomImage(encoding, referenceChannelNames(encoding).size(), seed);
+}
+
+// The message as decodeImage leaves it before copying the pixels
+static sensor_msgs::Image makeReceivedHeader(const sensor_msgs::Image &received)
+{
+	sensor_msgs::Image image;
+
+	image.encoding     = received.encoding;
+	image.width        = received.width;
+	image.height       = received.height;
+	image.is_bigendian = received.is_bigendian;
+	image.step         = received.step;
+
+	return image;
+}
+
+static void expectColorMatchesReference(const std::string &srcEncoding, const std::string &dstEncoding, bool flipVertical)
+{
+	SCOPED_TRACE(srcEncoding + " -> " + dstEncoding + (flipVertical ? " flipped" : ""));
+
+	sensor_msgs::Image received = makeColorImage(srcEncoding, 1);
+	sensor_msgs::Image image    = makeReceivedHeader(received);
+
+	ImageTransform transform;
+	transform.flipVertical = flipVertical;
+	transform.encoding     = dstEncoding;
+
+	ASSERT_TRUE(copyImageData(&received.data[0], received.data.size(), transform, image));
+
+	std::vector<uint8_t> expectedData;
+	referenceConvertColor(received, dstEncoding, flipVertical, expectedData);
+
+	EXPECT_EQ(dstEncoding, image.encoding);
+	EXPECT_EQ(testWidth * referenceChannelNames(dstEncoding).size(), image.step);
+	EXPECT_EQ(expectedData, image.data);
+}
+
+TEST(CopyImageData, ChannelOrderMatchesReference)
+{
+	for(int src=0; src<4; src++)
+	{
+		for(int dst=0; dst<4; dst++)
+		{
+			// The same encoding is copied with its rows as received (FlipKeepsRowPadding), and an alpha channel is never added
+			if(dst == src || referenceChannelNames(colorEncodings[dst]).size() > referenceChannelNames(colorEncodings[src]).size()){ continue; }
+
+			expectColorMatchesReference(colorEncodings[src], colorEncodings[dst], false);
+			expectColorMatchesReference(colorEncodings[src], colorEncodings[dst], true);
+		}
+	}
+}
+
+TEST(CopyImageData, FlipKeepsRowPadding)
+{
+	sensor_msgs::Image received = makeColorImage(sensor_msgs::image_encodings::RGB8, 2);
+	sensor_msgs::Image image    = makeReceivedHeader(received);
+
+	ImageTransform transform;
+	transform.flipVertical = true;
+
+	ASSERT_TRUE(copyImageData(&received.data[0], received.data.size(), transform, image));
+
+	ASSERT_EQ(received.step, image.step);
+	ASSERT_EQ(received.data.size(), image.data.size());
+
+	for(uint32_t v=0; v<testHeight; v++)
+	{
+		EXPECT_EQ(0, memcmp(&image.data[(size_t)v * image.step], &received.data[(size_t)(testHeight-1-v) * received.step], received.step)) << "v=" << v;
+	}
+}
+
+TEST(CopyImageData, AlphaIsNotAdded)
+{
+	sensor_msgs::Image received = makeColorImage(sensor_msgs::image_encodings::RGB8, 3);
+	sensor_msgs::Image image    = makeReceivedHeader(received);
+
+	ImageTransform transform;
+	transform.encoding = sensor_msgs::image_encodings::RGBA8;
+
+	// Copied as received
+	EXPECT_FALSE(copyImageData(&received.data[0], received.data.size(), transform, image));
+	EXPECT_EQ(sensor_msgs::image_encodings::RGB8, image.encoding);
+	EXPECT_EQ(received.data, image.data);
+}
+
+static void expectDepthMatchesReference(const std::string &srcEncoding, bool isBigEndian, const std::string &dstEncoding, bool flipVertical)
+{
+	SCOPED_TRACE(srcEncoding + (isBigEndian ? " big-endian" : "") + " -> " + dstEncoding + (flipVertical ? " flipped" : ""));
+
+	sensor_msgs::Image received = makeRawDepthImage(srcEncoding, isBigEndian, 4);
+	sensor_msgs::Image image    = makeReceivedHeader(received);
+
+	ImageTransform transform;
+	transform.flipVertical = flipVertical;
+	transform.encoding     = dstEncoding;
+
+	ASSERT_TRUE(copyImageData(&received.data[0], received.data.size(), transform, image));
+
+	std::vector<uint8_t> expectedData;
+	referenceConvertDepth(received, dstEncoding, flipVertical, expectedData);
+
+	EXPECT_EQ(dstEncoding, image.encoding);
+	EXPECT_FALSE(image.is_bigendian);
+	ASSERT_EQ(expectedData.size() / testHeight, image.step);
+	ASSERT_EQ(expectedData.size(), image.data.size());
+
+	if(dstEncoding == sensor_msgs::image_encodings::TYPE_16UC1)
+	{
+		EXPECT_EQ(expectedData, image.data);
+		return;
+	}
+
+	const float *depths         = (const float *)&image.data[0];
+	const float *expectedDepths = (const float *)&expectedData[0];
+
+	for(size_t i=0; i<expectedData.size() / sizeof(float); i++)
+	{
+		if(std::isnan(expectedDepths[i])){ EXPECT_TRUE(std::isnan(depths[i])) << "i=" << i; }
+		else                             { EXPECT_FLOAT_EQ(expectedDepths[i], depths[i]) << "i=" << i; }
+	}
+}
+
+TEST(CopyImageData, DepthEncodingMatchesReference)
+{
+	const std::string floatDepth = sensor_msgs::image_encodings::TYPE_32FC1;
+	const std::string shortDepth = sensor_msgs::image_encodings::TYPE_16UC1;
+
+	for(int isBigEndian=0; isBigEndian<2; isBigEndian++)
+	{
+		for(int flipVertical=0; flipVertical<2; flipVertical++)
+		{
+			expectDepthMatchesReference(floatDepth, isBigEndian, shortDepth, flipVertical);
+			expectDepthMatchesReference(shortDepth, isBigEndian, floatDepth, flipVertical);
+		}
+
+		// Into the byte order of the host only
+		if(isBigEndian)
+		{
+			expectDepthMatchesReference(floatDepth, isBigEndian, floatDepth, false);
+			expectDepthMatchesReference(shortDepth, isBigEndian, shortDepth, true);
+		}
+	}
+}
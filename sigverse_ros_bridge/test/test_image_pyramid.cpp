@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include "image_pyramid.hpp"
+#include "reference_kernels.hpp"
+#include "test_images.hpp"
+
+static void expectDownscaleMatchesReference(const std::string &encoding, int channelNum)
+{
+	SCOPED_TRACE(encoding);
+
+	sensor_msgs::Image src = makeRandomImage(encoding, channelNum, 1);
+	sensor_msgs::Image dst;
+
+	ASSERT_TRUE(downscaleImage(src, dst));
+
+	EXPECT_EQ(encoding, dst.encoding);
+	EXPECT_EQ(testWidth  / 2, dst.width);
+	EXPECT_EQ(testHeight / 2, dst.height);
+	EXPECT_EQ(dst.width * channelNum, dst.step);
+
+	std::vector<uint8_t> expectedData;
+	referenceDownscale(src, channelNum, expectedData);
+
+	EXPECT_EQ(expectedData, dst.data);
+
+	// Within one level of the exact mean
+	for(uint32_t v=0; v<dst.height; v++)
+	{
+		for(uint32_t i=0; i<dst.step; i++)
+		{
+			const uint8_t *upper = &src.data[(size_t)(2*v) * src.step + (i / channelNum) * 2 * channelNum + i % channelNum];
+			const uint8_t *lower = upper + src.step;
+
+			double mean = (upper[0] + upper[channelNum] + lower[0] + lower[channelNum]) / 4.0;
+
+			ASSERT_NEAR(mean, dst.data[(size_t)v * dst.step + i], 1.0) << "v=" << v << " i=" << i;
+		}
+	}
+}
+
+TEST(DownscaleImage, MatchesReference)
+{
+	expectDownscaleMatchesReference(sensor_msgs::image_encodings::MONO8, 1);
+	expectDownscaleMatchesReference(sensor_msgs::image_encodings::BGR8,  3);
+	expectDownscaleMatchesReference(sensor_msgs::image_encodings::RGBA8, 4);
+}
+
+TEST(DownscaleImage, RejectsOtherEncodings)
+{
+	sensor_msgs::Image src = makeRandomImage(sensor_msgs::image_encodings::TYPE_16UC1, 2, 2);
+	sensor_msgs::Image dst;
+
+	EXPECT_FALSE(downscaleImage(src, dst));
+}
+
+TEST(DownscaleImage, RejectsImagesTooSmallToHalve)
+{
+	// 1 pixel wide, then 1 pixel high. Halving leaves no pixels.
+	const uint32_t sizes[][2] = { {1, testHeight}, {testWidth, 1}, {1, 1} };
+
+	for(size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); i++)
+	{
+		sensor_msgs::Image src = makeRandomImage(sensor_msgs::image_encodings::BGR8, 3, 3);
+		sensor_msgs::Image dst;
+
+		src.width  = sizes[i][0];
+		src.height = sizes[i][1];
+
+		EXPECT_FALSE(downscaleImage(src, dst)) << src.width << "x" << src.height;
+	}
+}
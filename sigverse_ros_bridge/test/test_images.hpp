@@ -0,0 +1,151 @@
+#ifndef SIGVERSE_TEST_IMAGES_HPP
+#define SIGVERSE_TEST_IMAGES_HPP
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <string.h>
+
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/image_encodings.h>
+
+#include "depth_conversion.hpp"
+
+/**
+ * Random inputs of the kernel tests, made from a seed so that a failure can be reproduced.
+ */
+
+// Odd and not a multiple of the pixels of a SIMD block, so that the scalar tails and the dropped edges of the pyramid are covered as well
+const uint32_t testWidth  = 37;
+const uint32_t testHeight = 7;
+
+// Bytes at the end of every row of a received image
+const uint32_t testRowPadding = 3;
+
+inline CameraModel makeCameraModel(uint32_t width, uint32_t height)
+{
+	CameraModel cameraModel;
+
+	cameraModel.width  = width;
+	cameraModel.height = height;
+	cameraModel.fx     = 30.5;
+	cameraModel.fy     = 31.0;
+	cameraModel.cx     = width  * 0.5 - 0.3;
+	cameraModel.cy     = height * 0.5 + 0.2;
+
+	return cameraModel;
+}
+
+// Random bytes in padded rows, as received
+inline sensor_msgs::Image makeRandomImage(const std::string &encoding, uint32_t pixelSize, unsigned seed)
+{
+	std::mt19937 random(seed);
+
+	sensor_msgs::Image image;
+
+	image.encoding     = encoding;
+	image.width        = testWidth;
+	image.height       = testHeight;
+	image.is_bigendian = false;
+	image.step         = testWidth * pixelSize + testRowPadding;
+	image.data.resize((size_t)image.step * testHeight);
+
+	for(size_t i=0; i<image.data.size(); i++){ image.data[i] = (uint8_t)random(); }
+
+	return image;
+}
+
+// Random depths in meters with zeros and, for 32FC1, NaNs in between
+inline sensor_msgs::Image makeDepthImage(const std::string &encoding, uint32_t width, uint32_t height, unsigned seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> meters(0.2f, 12.0f);
+
+	bool isShort = (encoding == sensor_msgs::image_encodings::TYPE_16UC1);
+
+	sensor_msgs::Image depth;
+
+	depth.encoding = encoding;
+	depth.width    = width;
+	depth.height   = height;
+	depth.step     = width * (isShort ? sizeof(uint16_t) : sizeof(float));
+	depth.data.resize((size_t)depth.step * height);
+
+	for(uint32_t v=0; v<height; v++)
+	{
+		for(uint32_t u=0; u<width; u++)
+		{
+			float meter = meters(random);
+
+			if(random() % 7 == 0){ meter = 0.0f; }
+			if(random() % 11 == 0 && !isShort){ meter = std::numeric_limits<float>::quiet_NaN(); }
+
+			uint8_t *pixel = &depth.data[(size_t)v * depth.step];
+
+			if(isShort)
+			{
+				uint16_t millimeters = (uint16_t)std::lround(meter * 1000.0f);
+				memcpy(pixel + u * sizeof(uint16_t), &millimeters, sizeof(uint16_t));
+			}
+			else
+			{
+				memcpy(pixel + u * sizeof(float), &meter, sizeof(float));
+			}
+		}
+	}
+
+	return depth;
+}
+
+// Random depths with the invalid and out-of-range ones in between, in padded rows and the given byte order, as received
+inline sensor_msgs::Image makeRawDepthImage(const std::string &encoding, bool isBigEndian, unsigned seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> meters(0.0f, 70.0f); // Partly out of the range of 16UC1
+
+	bool isFloat = (encoding == sensor_msgs::image_encodings::TYPE_32FC1);
+
+	size_t pixelSize = isFloat ? sizeof(float) : sizeof(uint16_t);
+
+	const float specialDepths[] = { 0.0f, -1.0f, std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::infinity(), 65.535f, 65.536f };
+
+	sensor_msgs::Image image;
+
+	image.encoding     = encoding;
+	image.width        = testWidth;
+	image.height       = testHeight;
+	image.is_bigendian = isBigEndian;
+	image.step         = testWidth * pixelSize + testRowPadding;
+	image.data.resize((size_t)image.step * testHeight);
+
+	for(uint32_t v=0; v<testHeight; v++)
+	{
+		for(uint32_t u=0; u<testWidth; u++)
+		{
+			float meter = (random() % 5 == 0) ? specialDepths[random() % 6] : meters(random);
+
+			uint8_t bytes[4];
+
+			if(isFloat){ memcpy(bytes, &meter, sizeof(meter)); }
+			else
+			{
+				uint16_t millimeters = (uint16_t)(random() % 65536);
+				if(random() % 5 == 0){ millimeters = 0; }
+				memcpy(bytes, &millimeters, sizeof(millimeters));
+			}
+
+			uint8_t *pixel = &image.data[(size_t)v * image.step + u * pixelSize];
+
+			// The host is little-endian
+			for(size_t i=0; i<pixelSize; i++)
+			{
+				pixel[i] = bytes[isBigEndian ? pixelSize-1-i : i];
+			}
+		}
+	}
+
+	return image;
+}
+
+#endif // SIGVERSE_TEST_IMAGES_HPP
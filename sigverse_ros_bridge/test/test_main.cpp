@@ -0,0 +1,8 @@
+#include <gtest/gtest.h>
+
+// The tests of the package are linked into one executable
+int main(int argc, char **argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
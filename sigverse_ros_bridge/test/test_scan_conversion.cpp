@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+#include "scan_conversion.hpp"
+#include "reference_kernels.hpp"
+
+// Not a multiple of the SIMD width, so that the scalar tail is covered as well
+const int testBeamNum = 1081;
+
+// Random ranges with NaNs and ranges out of the limits in between
+static sensor_msgs::LaserScan makeScan(float angleMin, bool hasIntensity, unsigned seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> meters(0.0f, 35.0f);
+
+	sensor_msgs::LaserScan scan;
+
+	scan.angle_min       = angleMin;
+	scan.angle_increment = 0.25f * (float)M_PI / 180.0f;
+	scan.angle_max       = angleMin + (testBeamNum-1) * scan.angle_increment;
+	scan.range_min       = 0.1f;
+	scan.range_max       = 30.0f;
+
+	for(int i=0; i<testBeamNum; i++)
+	{
+		float range = meters(random);
+
+		if(random() % 13 == 0){ range = std::numeric_limits<float>::quiet_NaN(); }
+
+		scan.ranges.push_back(range);
+
+		if(hasIntensity){ scan.intensities.push_back((float)(random() % 1000)); }
+	}
+
+	return scan;
+}
+
+static void expectCloudMatchesReference(ScanCloudProjector &projector, const sensor_msgs::LaserScan &scan)
+{
+	sensor_msgs::PointCloud2 cloud;
+
+	projector.project(scan, cloud);
+
+	std::vector<float> expectedPoints;
+	referenceScanCloud(scan, expectedPoints);
+
+	ASSERT_EQ(expectedPoints.size() / 4, cloud.width);
+	ASSERT_EQ(1u,  cloud.height);
+	ASSERT_EQ(16u, cloud.point_step);
+	ASSERT_EQ((size_t)cloud.row_step, cloud.data.size());
+
+	const float *points = (const float *)&cloud.data[0];
+
+	for(size_t i=0; i<expectedPoints.size(); i++)
+	{
+		EXPECT_NEAR(expectedPoints[i], points[i], 1.0e-5f * 30.0f) << "point=" << i/4 << " field=" << i%4;
+	}
+}
+
+TEST(ScanCloudProjector, MatchesReference)
+{
+	ScanCloudProjector projector;
+
+	expectCloudMatchesReference(projector, makeScan(-2.35f, true, 1));
+}
+
+TEST(ScanCloudProjector, WithoutIntensities)
+{
+	ScanCloudProjector projector;
+
+	expectCloudMatchesReference(projector, makeScan(-2.35f, false, 2));
+}
+
+// The cached tables follow the angles of the scan
+TEST(ScanCloudProjector, AnglesChange)
+{
+	ScanCloudProjector projector;
+
+	expectCloudMatchesReference(projector, makeScan(-2.35f, true, 3));
+	expectCloudMatchesReference(projector, makeScan(-1.0f,  true, 4));
+}